@@ -9,5 +9,6 @@
 -T route_delay_cb
 -T swq_state_t
 -T timer_cb
+-T timer_handle_t
 -T twim_cb
 -T uint8_t
@@ -0,0 +1,121 @@
+/*
+ * bus_load.c
+ *
+ * Loconet bus load estimate and adaptive command pacing.
+ *
+ * Bus utilisation is estimated from the number of packets seen on the bus
+ * within a fixed window. Most packets are 4 bytes, taking about 2.4 ms on the
+ * wire plus at least 1.2 ms of carrier detect backoff.
+ * The command gap follows the load estimate, and is doubled on collisions.
+ *
+ * Created: 19-10-2026 09:12:52
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "bus_load.h"
+#include "fb_handler.h"
+#include "sw_handler.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#define WINDOW_MS       250
+#define WINDOW_TICKS    TICKS_FROM_MS(WINDOW_MS)
+#define PACKET_TIME_US  3600UL
+
+#define GAP_MIN         TICKS_FROM_MS(10)
+#define GAP_MAX         TICKS_FROM_MS(400)
+#define GAP_INIT        TICKS_FROM_MS(50)
+
+static ticks_t  window_start = 0;
+static uint16_t fb_cnt_last = 0;
+static uint16_t sw_cnt_last = 0;
+static uint8_t  tx_cnt = 0;
+static uint8_t  coll_cnt = 0;
+
+static uint8_t  load = 0;        // Percent
+static uint16_t load_x16 = 0;   // Smoothed load in 1/16 percent
+static ticks_t  gap = GAP_INIT;
+static uint16_t coll_total = 0;
+
+
+void bus_load_update(void)
+{
+    uint16_t        fb_cnt, sw_cnt, packets;
+    uint32_t        sample;
+    ticks_t         target;
+
+    if (ticks_now_elapsed(window_start) < WINDOW_TICKS)
+        return;
+    window_start = ticks_now();
+
+    fb_cnt = fb_handler_get_packets_received();
+    sw_cnt = sw_handler_get_packets_received();
+    packets = (uint16_t)(fb_cnt - fb_cnt_last) + (uint16_t)(sw_cnt - sw_cnt_last) + tx_cnt;
+    fb_cnt_last = fb_cnt;
+    sw_cnt_last = sw_cnt;
+    tx_cnt = 0;
+
+    // Utilisation in percent for this window, smoothed over ~4 windows
+    sample = (packets * PACKET_TIME_US) / (WINDOW_MS * 10UL);
+    if (sample > 100)
+        sample = 100;
+    // Kept in 1/16 percent, so it decays to 0 and doesn't stick at a few percent
+    load_x16 = (3 * load_x16 + 16 * sample) / 4;
+    load = (load_x16 + 8) / 16;
+
+    if (coll_cnt)
+    {
+        // Collisions. Back off fast
+        coll_cnt = 0;
+        gap *= 2;
+        if (gap > GAP_MAX)
+            gap = GAP_MAX;
+        return;
+    }
+
+    target = GAP_MIN + ((GAP_MAX - GAP_MIN) * load) / 100;
+    if (target > gap)
+        gap = target;
+    else
+        gap -= (gap - target + 3) / 4;
+}
+
+
+void bus_load_collision(void)
+{
+    if (coll_cnt < UINT8_MAX)
+        coll_cnt++;
+    coll_total++;
+}
+
+
+void bus_load_tx(void)
+{
+    if (tx_cnt < UINT8_MAX)
+        tx_cnt++;
+}
+
+
+ticks_t bus_load_gap(void)
+{
+    return gap;
+}
+
+
+uint8_t bus_load_get(void)
+{
+    return load;
+}
+
+
+static void busCmd(uint8_t argc, char *argv[])
+{
+    printf_P(PSTR("Bus load:   %u %%\n"), load);
+    printf_P(PSTR("Cmd gap:    %u ms\n"), (uint16_t)((gap * 1000UL) / TICKS_PER_SEC));
+    printf_P(PSTR("Collisions: %u\n"), coll_total);
+}
+
+CMD(bus, "Bus load and command pacing");
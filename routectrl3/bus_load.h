@@ -0,0 +1,51 @@
+/*
+ * bus_load.h
+ *
+ * Loconet bus load estimate and adaptive command pacing.
+ * Gaps between transmitted commands are tightened when the bus is quiet,
+ * and widened when traffic or collisions increase.
+ *
+ * Created: 19-10-2026 09:12:40
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#ifndef BUS_LOAD_H_
+#define BUS_LOAD_H_
+
+#include <stdint.h>
+#include "ticks.h"
+
+/**
+ * Update bus load module.
+ *
+ * Call regularly from mainloop.
+ */
+extern void     bus_load_update(void);
+
+/**
+ * Report a Loconet transmit collision.
+ */
+extern void     bus_load_collision(void);
+
+/**
+ * Report a transmitted Loconet packet.
+ *
+ * Only needed for packets that are not echoed back to ln_rx.
+ */
+extern void     bus_load_tx(void);
+
+/**
+ * Get current gap between transmitted commands.
+ *
+ * @return Gap in ticks.
+ */
+extern ticks_t  bus_load_gap(void);
+
+/**
+ * Get current bus load estimate.
+ *
+ * @return Bus utilisation in percent.
+ */
+extern uint8_t  bus_load_get(void);
+
+#endif /* BUS_LOAD_H_ */
@@ -0,0 +1,146 @@
+/*
+ * capture.c
+ *
+ * Loconet traffic capture into a RAM ring.
+ *
+ * When the ring is full the oldest records are overwritten, so the ring
+ * always holds the traffic leading up to now. 'cap d' dumps one record per
+ * line: ticks, RX/TX, FB/SW, address and value.
+ *
+ * A dump is replayed in the host build (tools/host/replay.py), not here,
+ * as replay on the board would send real commands to the layout.
+ *
+ * 'cap i' injects a single packet into the RX handlers, as if received from
+ * Loconet, for manual tests on the board. Golden trace scenarios run in the
+ * host build (tools/host/golden_trace.py).
+ *
+ * Created: 19-10-2026 20:15:52
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "capture.h"
+#include "term.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+#include "lib/loconet-avrda/ln_rx.h"
+
+#ifndef CAPTURE_RECS
+#define CAPTURE_RECS 128
+#endif
+
+typedef struct
+{
+    ticks_t         t;
+    uint16_t        adr;
+    uint8_t         type;
+    uint8_t         val;
+} capture_rec_t;
+
+static capture_rec_t ring[CAPTURE_RECS];
+static uint16_t ring_widx = 0;
+static uint16_t ring_cnt = 0;
+static bool     capturing = false;
+
+static uint16_t dump_pos;       // Counted from oldest record
+
+
+static capture_rec_t *rec_get(uint16_t pos)
+{
+    uint16_t        idx = ring_widx + CAPTURE_RECS - ring_cnt + pos;
+
+    return &ring[idx % CAPTURE_RECS];
+}
+
+
+void capture_put(capture_type_t type, uint16_t adr, uint8_t val)
+{
+    capture_rec_t  *r;
+
+    if (!capturing)
+        return;
+
+    r = &ring[ring_widx];
+    r->t = ticks_get();
+    r->adr = adr;
+    r->type = type;
+    r->val = val;
+    if (++ring_widx >= CAPTURE_RECS)
+        ring_widx = 0;
+    if (ring_cnt < CAPTURE_RECS)
+        ring_cnt++;
+}
+
+
+static bool cap_dump_cont(void)
+{
+    capture_rec_t  *r;
+
+    if (dump_pos >= ring_cnt)
+        return false;
+
+    r = rec_get(dump_pos++);
+    printf_P(PSTR("%10lu %S %S %4u %u\n"), r->t,
+             (r->type == CAPTURE_RX_FB || r->type == CAPTURE_RX_SW) ? PSTR("RX") : PSTR("TX"),
+             (r->type == CAPTURE_RX_FB || r->type == CAPTURE_TX_FB) ? PSTR("FB") : PSTR("SW"), r->adr, r->val);
+    return dump_pos < ring_cnt;
+}
+
+static void capCmd(uint8_t argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf_P(PSTR("Capture %S, %u of %u records\n"), capturing ? PSTR("on") : PSTR("off"),
+                 ring_cnt, CAPTURE_RECS);
+        printf_P(PSTR("Usage: cap <on|off|c|d|i>\n"));
+        printf_P(PSTR(" on  : Start capture\n"));
+        printf_P(PSTR(" off : Stop capture\n"));
+        printf_P(PSTR(" c   : Clear capture\n"));
+        printf_P(PSTR(" d   : Dump capture\n"));
+        printf_P(PSTR(" i f <adr> <occ> : Inject OPC_INPUT_REP\n"));
+        printf_P(PSTR(" i s <adr> <dir> : Inject OPC_SW_REQ\n"));
+        return;
+    }
+
+    switch (argv[1][0])
+    {
+    case 'o':
+        capturing = argv[1][1] == 'n';
+        break;
+
+    case 'c':
+        ring_widx = 0;
+        ring_cnt = 0;
+        break;
+
+    case 'd':
+        dump_pos = 0;
+        if (ring_cnt)
+            term_continue(cap_dump_cont);
+        break;
+
+    case 'i':
+        if (argc < 5)
+        {
+            printf_P(PSTR("Missing argument\n"));
+            break;
+        }
+        if (!strcmp_P(argv[2], PSTR("f")))
+            ln_rx_opc_input_rep(strtoul(argv[3], NULL, 0), strtoul(argv[4], NULL, 0) != 0, 1);
+        else if (!strcmp_P(argv[2], PSTR("s")))
+            ln_rx_opc_sw_req(strtoul(argv[3], NULL, 0), strtoul(argv[4], NULL, 0) != 0, 1);
+        else
+            printf_P(PSTR("Unknown argument\n"));
+        break;
+
+    default:
+        printf_P(PSTR("Unknown argument\n"));
+        break;
+    }
+}
+
+CMD(cap, "Loconet capture");
@@ -0,0 +1,36 @@
+/*
+ * capture.h
+ *
+ * Loconet traffic capture into a RAM ring.
+ *
+ * Created: 19-10-2026 20:15:38
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    CAPTURE_RX_FB,              // OPC_INPUT_REP received
+    CAPTURE_RX_SW,              // OPC_SW_REQ received
+    CAPTURE_TX_FB,              // OPC_INPUT_REP sent
+    CAPTURE_TX_SW               // OPC_SW_REQ sent
+} capture_type_t;
+
+/**
+ * Capture a packet.
+ *
+ * Does nothing if capture is off.
+ *
+ * @param type Packet type and direction.
+ * @param adr  Feedback or switch address.
+ * @param val  Feedback: 1 if occupied. Switch: bit 0 = dir (1 = G), bit 1 = on.
+ */
+extern void     capture_put(capture_type_t type, uint16_t adr, uint8_t val);
+
+#endif /* CAPTURE_H_ */
@@ -10,9 +10,12 @@
  *
  * This file adds a longer pulse (250 ms) on port D3 whenever a collision
  * happens, but only if CCLDEBUG is NOT defined.
+ *
+ * Collisions are always reported to bus_load for command pacing.
  */
 
 #include <avr/io.h>
+#include "bus_load.h"
 #include "ticks.h"
 #include "lib/loconet-avrda/hal_ln.h"
 
@@ -31,13 +34,16 @@ void collision_check_init(void)
 
 void collision_check_update(void)
 {
-#ifndef CCLDEBUG
     if (hal_ln_tx_collision())
     {
+        bus_load_collision();
+#ifndef CCLDEBUG
         PORTD.OUTSET = PIN3_bm;
-        coll_time = ticks_get();
+        coll_time = ticks_now();
+#endif
     }
-    else if (ticks_elapsed(coll_time) >= COLLISION_TICKS)
+#ifndef CCLDEBUG
+    else if (ticks_now_elapsed(coll_time) >= COLLISION_TICKS)
     {
         PORTD.OUTCLR = PIN3_bm;
     }
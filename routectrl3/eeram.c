@@ -154,7 +154,7 @@ void eeram_update(void)
     case EERAM_STATE_INIT:
         if (twim_read(EERAM_CTRL_ADR, buffer, sizeof(eeram_buf_status_t), status_cb))
         {
-            tstart = ticks_get();
+            tstart = ticks_now();
             state = EERAM_STATE_BUSY;
         }
         break;
@@ -169,14 +169,14 @@ void eeram_update(void)
             buffer[1] = status.data;
             if (twim_write(EERAM_CTRL_ADR, buffer, 2, set_ase_cb))
             {
-                tstart = ticks_get();
+                tstart = ticks_now();
                 state = EERAM_STATE_BUSY;
             }
             break;
         }
 
     case EERAM_STATE_IDLE:
-        if (writestack_cnt > 0 && twim_ready())
+        if (writestack_cnt > 0)
         {
             // Write new byte to EERAM
             uint8_t         i = writestack_cnt - 1;
@@ -187,14 +187,14 @@ void eeram_update(void)
             if (twim_write(EERAM_SRAM_ADR, buffer, 3, twi_done_cb))
             {
                 writestack_cnt = i;
-                tstart = ticks_get();
+                tstart = ticks_now();
                 state = EERAM_STATE_BUSY;
             }
         }
         break;
 
     case EERAM_STATE_BUSY:
-        if (ticks_elapsed(tstart) >= TWI_TIMEOUT)
+        if (ticks_now_elapsed(tstart) >= TWI_TIMEOUT)
         {
             printf_P(PSTR("TWI timeout\n"));
             state = EERAM_STATE_ERROR;
@@ -216,13 +216,13 @@ bool eeram_ready(void)
 
 bool eeram_read(uint16_t adr, uint8_t *buf, uint16_t len)
 {
-    if (!eeram_ready() || !twim_ready())
+    if (!eeram_ready())
         return false;
     buffer[0] = adr >> 8;       // High byte first
     buffer[1] = adr & 0xff;     // Low byte
     if (twim_write_read(EERAM_SRAM_ADR, buffer, 2, buf, len, twi_done_cb))
     {
-        tstart = ticks_get();
+        tstart = ticks_now();
         state = EERAM_STATE_BUSY;
         return true;
     }
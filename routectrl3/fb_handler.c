@@ -13,8 +13,15 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "capture.h"
 #include "fb_handler.h"
 #include "flashmem.h"
+#include "latency.h"
+#include "local_fb.h"
+#include "perf.h"
+#include "reflex.h"
+#include "statestream.h"
+#include "term.h"
 #include "lib/avr-shell-cmd/cmd.h"
 #include "lib/loconet-avrda/hal_ln.h"
 #include "lib/loconet-avrda/ln_rx.h"
@@ -41,18 +48,23 @@ extern const FLASHMEM feedbackrange_table_t __loconet_fbrangefreetable_end;
 void fb_handler_set_state(uint16_t adr, bool l)
 {
     uint16_t        idx;
-    uint8_t         mask;
+    uint8_t         mask, val;
 
     if (adr == 0 || adr > FEEDBACK_ADR_MAX)
         return;
 
-    adr--;
-    idx = adr / 8;
-    mask = __builtin_avr_mask1(1, adr & 7);
+    idx = (adr - 1) / 8;
+    mask = __builtin_avr_mask1(1, (adr - 1) & 7);
+    val = feedback_state[idx];
     if (l)                      // Occupied
-        feedback_state[idx] |= mask;
+        val |= mask;
     else                        // Free
-        feedback_state[idx] &= ~mask;
+        val &= ~mask;
+    if (val != feedback_state[idx])
+    {
+        feedback_state[idx] = val;
+        statestream_fb(adr, l);
+    }
 }
 
 
@@ -71,18 +83,38 @@ bool fb_handler_get_state(uint16_t adr)
 }
 
 
+static uint16_t list_adr, list_end;
+
+static bool fb_list_cont(void)
+{
+    printf_P(PSTR("Feedback %u: %S\n"), list_adr, fb_handler_get_state(list_adr) ? PSTR("Occupied") : PSTR("Free"));
+    return list_adr++ < list_end;
+}
+
 static void fbCmd(uint8_t argc, char *argv[])
 {
     uint16_t        adr;
 
     if (argc < 2)
     {
-        printf_P(PSTR("Usage: fb <adr>\n"));
+        printf_P(PSTR("Usage: fb <adr> [<adrto>]\n"));
         printf_P(PSTR(" <adr>   : Feedback address\n"));
+        printf_P(PSTR(" <adrto> : List feedback addresses from adr to adrto\n"));
         return;
     }
 
     adr = strtoul(argv[1], NULL, 0);
+    if (argc >= 3)
+    {
+        list_adr = adr;
+        list_end = strtoul(argv[2], NULL, 0);
+        if (list_end > FEEDBACK_ADR_MAX)
+            list_end = FEEDBACK_ADR_MAX;
+        if (list_adr <= list_end)
+            term_continue(fb_list_cont);
+        return;
+    }
+
     if (fb_handler_get_state(adr))
         printf_P(PSTR("Occupied\n"));
     else
@@ -95,72 +127,57 @@ CMD(fb, "Feedback");
 #if __GNUC__ < 15
 // Old compiler probably means old linker. Use linear search as table isn't numerically sorted
 
-static void feedback_callback(uint16_t adr, uint8_t l)
+static const FLASHMEM feedback_table_t *feedback_find(const FLASHMEM feedback_table_t *p,
+                                                      const FLASHMEM feedback_table_t *pend, uint16_t adr)
 {
-    const FLASHMEM feedback_table_t *p, *pend;
-    bool            found = false;
-
-    if (l != 0)                 // Occupied
-    {
-        p = &__loconet_fbocctable_start;
-        pend = &__loconet_fbocctable_end;
-    }
-    else                        // Free
-    {
-        p = &__loconet_fbfreetable_start;
-        pend = &__loconet_fbfreetable_end;
-    }
-
-    while (p < pend)
-    {
-        if (p->adr == adr)
-        {
-            p->cb(adr);
-            found = true;
-        }
-        else if (found)
-        {
-            break;
-        }
+    while (p < pend && p->adr != adr)
         p++;
-    }
+
+    return p;
 }
 
 #else
 // Linker has sorted the table numerically. Use binary search
 
-static void feedback_callback(uint16_t adr, uint8_t l)
+static const FLASHMEM feedback_table_t *feedback_find(const FLASHMEM feedback_table_t *p,
+                                                      const FLASHMEM feedback_table_t *pend, uint16_t adr)
 {
-    const FLASHMEM feedback_table_t *p, *pend;
     uint16_t        low, high, mid;
 
-    if (l != 0)                 // Occupied
-    {
-        p = &__loconet_fbocctable_start;
-        pend = &__loconet_fbocctable_end;
-    }
-    else                        // Free
-    {
-        p = &__loconet_fbfreetable_start;
-        pend = &__loconet_fbfreetable_end;
-    }
     low = 0;
     high = pend - p;
 
     for (;;)
     {
         if (low >= high)
-        {
-            p = p + low;
-            break;
-        }
+            return p + low;
         mid = low + ((high - low) >> 1);
         if ((p + mid)->adr < adr)
             low = mid + 1;
         else
             high = mid;
     }
+}
+
+#endif
+
+static void feedback_callback(uint16_t adr, uint8_t l)
+{
+    const FLASHMEM feedback_table_t *p, *pend;
+
+    if (l != 0)                 // Occupied
+    {
+        p = &__loconet_fbocctable_start;
+        pend = &__loconet_fbocctable_end;
+    }
+    else                        // Free
+    {
+        p = &__loconet_fbfreetable_start;
+        pend = &__loconet_fbfreetable_end;
+    }
 
+    // Callbacks for the same address are next to each other
+    p = feedback_find(p, pend, adr);
     while (p < pend && p->adr == adr)
     {
         p->cb(adr);
@@ -168,8 +185,6 @@ static void feedback_callback(uint16_t adr, uint8_t l)
     }
 }
 
-#endif
-
 
 static void feedback_range_callback(uint16_t adr, uint8_t l)
 {
@@ -194,21 +209,57 @@ static void feedback_range_callback(uint16_t adr, uint8_t l)
     }
 }
 
+void fb_handler_input(uint16_t adr, bool l)
+{
+    latency_cause_t prev = latency_cause_set(latency_cause_now());
+
+    reflex_input(adr, l);
+    fb_handler_set_state(adr, l);
+
+    feedback_callback(adr, l);
+    feedback_range_callback(adr, l);
+
+    latency_cause_set(prev);
+}
+
 void ln_rx_opc_input_rep(uint16_t adr, uint8_t l, uint8_t x)
 {
+    hrticks_t       t0;
 
     if (!x)
         return;
 
     feedback_cnt++;
+    capture_put(CAPTURE_RX_FB, adr, l != 0);
 
-    fb_handler_set_state(adr, l != 0);
+    // Local inputs are handled directly. Ignore reports (or own echo) from Loconet
+    if (local_fb_is_local(adr))
+        return;
 
-    feedback_callback(adr, l);
-    feedback_range_callback(adr, l);
+    t0 = ticks_hr_get();
+    fb_handler_input(adr, l != 0);
+    perf_record(PERF_DISPATCH_FB, ticks_hr_elapsed(t0));
 }
 
 uint16_t fb_handler_get_packets_received(void)
 {
     return feedback_cnt;
 }
+
+hrticks_t fb_handler_bench(uint16_t n)
+{
+    const FLASHMEM feedback_table_t *volatile sink;
+    uint16_t        adr = 1;
+    hrticks_t       t0;
+
+    t0 = ticks_hr_get();
+    while (n--)
+    {
+        sink = feedback_find(&__loconet_fbocctable_start, &__loconet_fbocctable_end, adr);
+        if (++adr > FEEDBACK_ADR_MAX)
+            adr = 1;
+    }
+    (void)sink;
+
+    return ticks_hr_elapsed(t0);
+}
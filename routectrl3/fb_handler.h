@@ -13,6 +13,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "ticks.h"
 
 /**
  * Feedback subscriber callback function prototype.
@@ -100,6 +101,18 @@ typedef struct
  */
 extern void     fb_handler_set_state(uint16_t adr, bool l);
 
+/**
+ * Handle feedback input.
+ *
+ * Sets the feedback state and calls feedback subscribers,
+ * as if the feedback was received from Loconet.
+ * Calling this function does NOT send a Loconet packet.
+ *
+ * @param adr Feedback address.
+ * @param l   True if occupied.
+ */
+extern void     fb_handler_input(uint16_t adr, bool l);
+
 /**
  * Get state of feedback address.
  *
@@ -116,4 +129,15 @@ extern bool     fb_handler_get_state(uint16_t adr);
  */
 extern uint16_t fb_handler_get_packets_received(void);
 
+/**
+ * Benchmark the feedback subscriber table search (as used by
+ * feedback_callback, without calling the subscribers).
+ * Searches the occupied table for all feedback addresses in turn.
+ * Blocks for the whole run.
+ *
+ * @param n Number of searches.
+ * @return  Cycles (hrticks) spent, including loop overhead.
+ */
+extern hrticks_t fb_handler_bench(uint16_t n);
+
 #endif /* FB_HANDLER_H_ */
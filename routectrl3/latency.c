@@ -0,0 +1,216 @@
+/*
+ * latency.c
+ *
+ * End-to-end latency from feedback received to resulting output sent.
+ *
+ * Histogram buckets are powers of 2 in ticks (about ms): <2, <4, ... <512,
+ * and 512 or more. One histogram for all outputs, and one for each of
+ * LATENCY_ADR_CNT output addresses. When they are all in use, the address
+ * with the lowest max is replaced by a new address with a higher latency,
+ * so the worst addresses are kept.
+ *
+ * Created: 19-10-2026 18:40:29
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+#include "lib/loconet-avrda/ln_tx.h"
+
+#ifndef LATENCY_ADR_CNT
+#define LATENCY_ADR_CNT 16
+#endif
+
+#define TX_SLOTS 8              // Packets with latency in the Loconet tx buffer
+
+#define BUCKETS 10
+
+typedef struct
+{
+    uint16_t        adr;
+    uint16_t        max;        // ticks
+    uint16_t        hist[BUCKETS];
+} latency_hist_t;
+
+typedef struct
+{
+    uint16_t        adr;
+    latency_cause_t cause;      // LATENCY_CAUSE_NONE if slot is free
+} latency_tx_t;
+
+static latency_cause_t cur_cause = LATENCY_CAUSE_NONE;
+static latency_hist_t total;
+static latency_hist_t per_adr[LATENCY_ADR_CNT];
+static uint8_t  per_adr_cnt = 0;
+static uint16_t per_adr_replaced = 0;
+static bool     per_adr_full = false;   // An address was left out
+static latency_tx_t tx_slot[TX_SLOTS];
+
+
+latency_cause_t latency_cause_now(void)
+{
+    latency_cause_t c = ticks_get();
+
+    return c == LATENCY_CAUSE_NONE ? 1 : c;
+}
+
+
+latency_cause_t latency_cause_get(void)
+{
+    return cur_cause;
+}
+
+
+latency_cause_t latency_cause_set(latency_cause_t cause)
+{
+    latency_cause_t prev = cur_cause;
+
+    cur_cause = cause;
+    return prev;
+}
+
+
+static void hist_add(latency_hist_t *h, uint16_t t)
+{
+    uint8_t         b = 0;
+
+    while (b < BUCKETS - 1 && t >= (2U << b))
+        b++;
+    if (h->hist[b] < UINT16_MAX)
+        h->hist[b]++;
+    if (t > h->max)
+        h->max = t;
+}
+
+static uint8_t adr_slot(uint16_t adr, uint16_t t)
+{
+    uint8_t         i, low;
+
+    for (i = 0; i < per_adr_cnt; i++)
+    {
+        if (per_adr[i].adr == adr)
+            return i;
+    }
+    if (per_adr_cnt < LATENCY_ADR_CNT)
+    {
+        per_adr[per_adr_cnt].adr = adr;
+        return per_adr_cnt++;
+    }
+
+    // All in use. Replace the address with the lowest max, if this is worse
+    per_adr_full = true;
+    for (i = 1, low = 0; i < LATENCY_ADR_CNT; i++)
+    {
+        if (per_adr[i].max < per_adr[low].max)
+            low = i;
+    }
+    if (t <= per_adr[low].max)
+        return LATENCY_ADR_CNT;
+    if (per_adr_replaced < UINT16_MAX)
+        per_adr_replaced++;
+    memset(&per_adr[low], 0, sizeof(per_adr[low]));
+    per_adr[low].adr = adr;
+    return low;
+}
+
+void latency_record(uint16_t adr, latency_cause_t cause)
+{
+    uint16_t        t;
+    uint8_t         i;
+
+    if (cause == LATENCY_CAUSE_NONE)
+        return;
+
+    t = latency_cause_now() - cause;
+    hist_add(&total, t);
+
+    i = adr_slot(adr, t);
+    if (i < LATENCY_ADR_CNT)
+        hist_add(&per_adr[i], t);
+}
+
+
+static void tx_done(void *ctx, hal_ln_result_t res)
+{
+    latency_tx_t   *s = ctx;
+
+    if (res == HAL_LN_SUCCESS)
+        latency_record(s->adr, s->cause);
+    s->cause = LATENCY_CAUSE_NONE;
+}
+
+int8_t latency_tx_input_rep(uint16_t adr, bool l, latency_cause_t cause)
+{
+    latency_tx_t   *s = NULL;
+    uint8_t         i;
+    int8_t          res;
+
+    if (cause != LATENCY_CAUSE_NONE)
+    {
+        for (i = 0; i < TX_SLOTS; i++)
+        {
+            if (tx_slot[i].cause == LATENCY_CAUSE_NONE)
+            {
+                s = &tx_slot[i];
+                break;
+            }
+        }
+    }
+
+    // Without a free slot, the packet is sent without measuring
+    if (!s)
+        return ln_tx_opc_input_rep(adr, l, NULL, NULL);
+
+    s->adr = adr | LATENCY_ADR_FB;
+    s->cause = cause;
+    res = ln_tx_opc_input_rep(adr, l, tx_done, s);
+    if (res != 0)
+        s->cause = LATENCY_CAUSE_NONE;
+    return res;
+}
+
+
+static void hist_print(const latency_hist_t *h)
+{
+    uint8_t         b;
+
+    for (b = 0; b < BUCKETS; b++)
+        printf_P(PSTR(" %5u"), h->hist[b]);
+    printf_P(PSTR(" %5u\n"), h->max);
+}
+
+static void latCmd(uint8_t argc, char *argv[])
+{
+    uint8_t         i;
+
+    if (argc >= 2 && argv[1][0] == 'r')
+    {
+        memset(&total, 0, sizeof(total));
+        memset(per_adr, 0, sizeof(per_adr));
+        per_adr_cnt = 0;
+        per_adr_replaced = 0;
+        per_adr_full = false;
+        return;
+    }
+
+    printf_P(PSTR("Latency in ticks. Feedback received to output sent\n"));
+    printf_P(PSTR("Adr        <2    <4    <8   <16   <32   <64  <128  <256  <512 >=512   max\n"));
+    printf_P(PSTR("All  "));
+    hist_print(&total);
+    for (i = 0; i < per_adr_cnt; i++)
+    {
+        printf_P(PSTR("%c%4u"), (per_adr[i].adr & LATENCY_ADR_FB) ? 'F' : 'S', per_adr[i].adr & ~LATENCY_ADR_FB);
+        hist_print(&per_adr[i]);
+    }
+    if (per_adr_full)
+        printf_P(PSTR("Only the %u worst addresses are shown (%u replaced)\n"), LATENCY_ADR_CNT, per_adr_replaced);
+}
+
+CMD(lat, "End-to-end latency. 'lat r' resets");
@@ -0,0 +1,74 @@
+/*
+ * latency.h
+ *
+ * End-to-end latency from feedback received to resulting output sent.
+ *
+ * A feedback sets the current cause while its subscribers run. Anything
+ * queued meanwhile (routes, route_queue, switch_queue) carries the cause
+ * along, and the latency is recorded when the packet has been sent
+ * (Loconet tx done), or when a local output is set.
+ *
+ * Created: 19-10-2026 18:40:13
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Cause tag. Time of the originating event in ticks (lower 16 bits).
+ * 0 if there is no cause.
+ */
+typedef uint16_t latency_cause_t;
+
+#define LATENCY_CAUSE_NONE 0
+
+#define LATENCY_ADR_FB     0x8000       // Added to feedback output addresses
+
+/**
+ * Get cause tag for an event happening now.
+ *
+ * @return Cause tag.
+ */
+extern latency_cause_t latency_cause_now(void);
+
+/**
+ * Get current cause.
+ *
+ * @return Cause tag, or LATENCY_CAUSE_NONE.
+ */
+extern latency_cause_t latency_cause_get(void);
+
+/**
+ * Set current cause.
+ *
+ * @param cause New cause tag, or LATENCY_CAUSE_NONE.
+ * @return Previous cause tag. Restore it when done.
+ */
+extern latency_cause_t latency_cause_set(latency_cause_t cause);
+
+/**
+ * Record latency of output sent now.
+ *
+ * Does nothing if cause is LATENCY_CAUSE_NONE.
+ *
+ * @param adr   Switch address, or feedback address + LATENCY_ADR_FB.
+ * @param cause Cause tag carried by the output.
+ */
+extern void     latency_record(uint16_t adr, latency_cause_t cause);
+
+/**
+ * Send OPC_INPUT_REP, and record latency when it has been sent.
+ *
+ * @param adr   Feedback address.
+ * @param l     True if occupied.
+ * @param cause Cause tag carried by the output.
+ * @return      0 if queued for sending, as ln_tx_opc_input_rep().
+ */
+extern int8_t   latency_tx_input_rep(uint16_t adr, bool l, latency_cause_t cause);
+
+#endif /* LATENCY_H_ */
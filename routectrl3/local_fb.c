@@ -0,0 +1,240 @@
+/*
+ * local_fb.c
+ *
+ * Local feedback inputs.
+ *
+ * All pins of a port or port expander are sampled at once, and debounced
+ * bit-parallel with 2-bit vertical counters. An input must be stable for
+ * 4 samples before a change is accepted. A change updates the feedback
+ * state and calls the feedback subscribers, exactly like a feedback
+ * received from Loconet.
+ *
+ * Created: 19-10-2026 16:04:52
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "fb_handler.h"
+#include "flashmem.h"
+#include "local_fb.h"
+#include "route.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#ifdef LOCAL_FB_TWI
+#include "twim.h"
+#endif
+
+#ifndef LOCAL_FB_GROUPS_MAX
+#define LOCAL_FB_GROUPS_MAX 8
+#endif
+
+#ifndef LOCAL_FB_SCAN_TICKS
+#define LOCAL_FB_SCAN_TICKS 1   // Sample interval. Debounce time is 4 samples
+#endif
+
+typedef struct
+{
+    uint8_t         state;      // Debounced state. 1 = occupied
+    uint8_t         cnt0;       // Vertical counter, bit 0
+    uint8_t         cnt1;       // Vertical counter, bit 1
+} local_fb_group_t;
+
+extern const FLASHMEM local_fb_table_t __loconet_localfbtable_start;
+extern const FLASHMEM local_fb_table_t __loconet_localfbtable_end;
+
+static local_fb_group_t group[LOCAL_FB_GROUPS_MAX];
+static uint8_t  group_cnt = 0;
+static uint16_t adr_min = UINT16_MAX, adr_max = 0;
+static ticks_t  last_scan;
+static uint16_t change_cnt = 0;
+
+#ifdef LOCAL_FB_TWI
+static uint8_t  twi_idx = LOCAL_FB_GROUPS_MAX;  // Group being read. LOCAL_FB_GROUPS_MAX if idle
+static uint8_t  twi_buf;
+static uint16_t twi_errors = 0;
+#endif
+
+
+static const FLASHMEM local_fb_table_t *entry(uint8_t idx)
+{
+    return &__loconet_localfbtable_start + idx;
+}
+
+static void group_sample(uint8_t idx, uint8_t sample)
+{
+    const FLASHMEM local_fb_table_t *p = entry(idx);
+    local_fb_group_t *g = &group[idx];
+    uint8_t         mask = p->mask;
+    uint8_t         delta;
+    uint16_t        adr;
+    bool            l;
+
+    if (p->flags & LOCAL_FB_ACTIVE_LOW)
+        sample = ~sample;
+
+    // Count down changed bits. Reset counter of unchanged bits
+    delta = (g->state ^ sample) & mask;
+    g->cnt0 = ~(g->cnt0 & delta);
+    g->cnt1 = g->cnt0 ^ (g->cnt1 & delta);
+    delta &= g->cnt0 & g->cnt1; // Counter rolled over: Stable for 4 samples
+    if (!delta)
+        return;
+
+    g->state ^= delta;
+    adr = p->adr;
+    for (uint8_t bit = 1; bit; bit <<= 1, adr++)
+    {
+        if (!(delta & bit))
+            continue;
+        l = (g->state & bit) != 0;
+        change_cnt++;
+        fb_handler_input(adr, l);
+        if (p->flags & LOCAL_FB_LN)
+            route_send_fb(adr, l);
+    }
+}
+
+
+#ifdef LOCAL_FB_TWI
+
+static void twi_next(void);
+
+static void twi_read_cb(twim_status_t ts)
+{
+    if (ts == TWIM_STATUS_DONE)
+        group_sample(twi_idx, twi_buf);
+    else
+        twi_errors++;
+    twi_idx++;
+    twi_next();
+}
+
+static void twi_next(void)
+{
+    // Find next port expander. Read one at a time, as the callback has no context
+    while (twi_idx < group_cnt && entry(twi_idx)->in != NULL)
+        twi_idx++;
+    if (twi_idx >= group_cnt)
+    {
+        twi_idx = LOCAL_FB_GROUPS_MAX;
+        return;
+    }
+    if (!twim_read(entry(twi_idx)->twiadr, &twi_buf, 1, twi_read_cb))
+        twi_idx = LOCAL_FB_GROUPS_MAX;  // Queue full. Retry next scan
+}
+
+#endif
+
+
+void local_fb_init(void)
+{
+    const FLASHMEM local_fb_table_t *p;
+    uint8_t         i;
+
+    group_cnt = &__loconet_localfbtable_end - &__loconet_localfbtable_start;
+    if (group_cnt > LOCAL_FB_GROUPS_MAX)
+    {
+        printf_P(PSTR("ERROR: Too many local feedback groups: %u\n"), group_cnt);
+        group_cnt = LOCAL_FB_GROUPS_MAX;
+    }
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        group[i].state = 0;
+        group[i].cnt0 = 0xff;
+        group[i].cnt1 = 0xff;
+        if (p->adr < adr_min)
+            adr_min = p->adr;
+        if (p->adr + 7 > adr_max)
+            adr_max = p->adr + 7;
+        if (p->port)
+        {
+            volatile uint8_t *pinctrl = &p->port->PIN0CTRL;
+
+            p->port->DIRCLR = p->mask;
+            for (uint8_t pin = 0; pin < 8; pin++)
+            {
+                if ((p->mask & (1 << pin)) && (p->flags & LOCAL_FB_ACTIVE_LOW))
+                    pinctrl[pin] = PORT_PULLUPEN_bm;
+            }
+        }
+    }
+
+    last_scan = ticks_now();
+}
+
+
+void local_fb_update(void)
+{
+    const FLASHMEM local_fb_table_t *p;
+    uint8_t         i;
+
+    if (group_cnt == 0 || ticks_now_elapsed(last_scan) < LOCAL_FB_SCAN_TICKS)
+        return;
+    last_scan += LOCAL_FB_SCAN_TICKS;
+    if (ticks_now_elapsed(last_scan) >= LOCAL_FB_SCAN_TICKS)
+        last_scan = ticks_now();        // Fell behind. Don't try to catch up
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        if (p->in)
+            group_sample(i, *p->in);
+    }
+
+#ifdef LOCAL_FB_TWI
+    if (twi_idx == LOCAL_FB_GROUPS_MAX)
+    {
+        twi_idx = 0;
+        twi_next();
+    }
+#endif
+}
+
+
+bool local_fb_is_local(uint16_t adr)
+{
+    const FLASHMEM local_fb_table_t *p;
+    uint8_t         i;
+
+    if (adr < adr_min || adr > adr_max)
+        return false;
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        if (adr >= p->adr && adr < p->adr + 8 && (p->mask & (1 << (adr - p->adr))))
+            return true;
+    }
+    return false;
+}
+
+
+static void lfbCmd(uint8_t argc, char *argv[])
+{
+    const FLASHMEM local_fb_table_t *p;
+    uint8_t         i;
+
+    printf_P(PSTR("Changes: %u\n"), change_cnt);
+#ifdef LOCAL_FB_TWI
+    printf_P(PSTR("TWI errors: %u\n"), twi_errors);
+#endif
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        if (p->in)
+            printf_P(PSTR("%u: Port  %c   "), i, 'A' + (p->in - &VPORTA.IN) / sizeof(VPORT_t));
+        else
+            printf_P(PSTR("%u: I2C   0x%02X"), i, p->twiadr);
+        printf_P(PSTR(" adr %4u-%4u mask %02X occ %02X%S\n"), p->adr, p->adr + 7, p->mask,
+                 group[i].state & p->mask, (p->flags & LOCAL_FB_LN) ? PSTR(" LN") : PSTR(""));
+    }
+}
+
+CMD(lfb, "Local feedback inputs");
@@ -0,0 +1,86 @@
+/*
+ * local_fb.h
+ *
+ * Local feedback inputs.
+ * Scans AVR port pins and I2C port expanders (PCF8574 type), debounces
+ * them and handles changes like feedback received from Loconet.
+ *
+ * Created: 19-10-2026 16:04:37
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef LOCAL_FB_H_
+#define LOCAL_FB_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOCAL_FB_ACTIVE_LOW 0x01        // Input is low when occupied
+#define LOCAL_FB_LN         0x02        // Also send changes on Loconet
+
+typedef struct
+{
+    volatile uint8_t *const in;         // VPORT input register. NULL if I2C
+    PORT_t         *const port;         // PORT for pin setup. NULL if I2C
+    const uint8_t   twiadr;             // I2C address (8-bit, already left-shifted)
+    const uint8_t   mask;               // Pins in use
+    const uint8_t   flags;
+    const uint16_t  adr;                // Feedback address of pin 0
+} local_fb_table_t;
+
+/**
+ * Local port feedback input macro.
+ *
+ * Pin n of the port is feedback address adr + n.
+ * Pull-ups are enabled on pins in use if active low.
+ *
+ * @param p Port letter (A, B, C...).
+ * @param m Mask of pins in use.
+ * @param a Feedback address of pin 0.
+ * @param f Flags. LOCAL_FB_ACTIVE_LOW and/or LOCAL_FB_LN, or 0.
+ */
+#define LOCAL_FB_GPIO(p, m, a, f) static const local_fb_table_t localfbgpio##p##a \
+    __attribute__((used, section("loconet.localfbtable"))) = \
+    {.in = &VPORT##p.IN, .port = &PORT##p, .twiadr = 0, .mask = m, .flags = f, .adr = a};
+
+/**
+ * Local I2C port expander feedback input macro.
+ *
+ * Requires LOCAL_FB_TWI to be defined.
+ * Bit n of the port expander is feedback address adr + n.
+ *
+ * @param t I2C address (8-bit, already left-shifted).
+ * @param m Mask of bits in use.
+ * @param a Feedback address of bit 0.
+ * @param f Flags. LOCAL_FB_ACTIVE_LOW and/or LOCAL_FB_LN, or 0.
+ */
+#define LOCAL_FB_I2C(t, m, a, f) static const local_fb_table_t localfbi2c##t##a \
+    __attribute__((used, section("loconet.localfbtable"))) = \
+    {.in = NULL, .port = NULL, .twiadr = t, .mask = m, .flags = f, .adr = a};
+
+
+/**
+ * Init local feedback module.
+ *
+ * Call once at startup.
+ */
+extern void     local_fb_init(void);
+
+/**
+ * Update local feedback module.
+ *
+ * Call regularly from mainloop.
+ */
+extern void     local_fb_update(void);
+
+/**
+ * Check if feedback address is a local input.
+ *
+ * @param adr Feedback address.
+ * @return True if address is handled by a local input.
+ */
+extern bool     local_fb_is_local(uint16_t adr);
+
+#endif /* LOCAL_FB_H_ */
@@ -0,0 +1,305 @@
+/*
+ * local_out.c
+ *
+ * Local outputs for signals (or anything else), addressed like switches.
+ *
+ * Created: 19-10-2026 17:11:40
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "flashmem.h"
+#include "local_out.h"
+#include "sw_handler.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#ifdef LOCAL_OUT_TWI
+#include "twim.h"
+#endif
+
+#ifndef LOCAL_OUT_GROUPS_MAX
+#define LOCAL_OUT_GROUPS_MAX 8
+#endif
+
+#ifndef LOCAL_OUT_SR_BYTES
+#define LOCAL_OUT_SR_BYTES 0    // Length of shift register chain. 0 if not used
+#endif
+
+#if LOCAL_OUT_SR_BYTES > 0
+#ifndef LOCAL_OUT_SR_VPORT
+#define LOCAL_OUT_SR_VPORT     VPORTD
+#define LOCAL_OUT_SR_DATA_bm   PIN0_bm
+#define LOCAL_OUT_SR_CLK_bm    PIN1_bm
+#define LOCAL_OUT_SR_LATCH_bm  PIN2_bm
+#endif
+#endif
+
+extern const FLASHMEM local_out_table_t __loconet_localouttable_start;
+extern const FLASHMEM local_out_table_t __loconet_localouttable_end;
+
+static uint8_t  out_state[LOCAL_OUT_GROUPS_MAX];        // Current state. 1 = G
+static uint8_t  group_cnt = 0;
+static uint16_t adr_min = UINT16_MAX, adr_max = 0;
+static uint16_t set_cnt = 0;
+
+#if LOCAL_OUT_SR_BYTES > 0
+static uint8_t  sr_buf[LOCAL_OUT_SR_BYTES];
+#endif
+
+#ifdef LOCAL_OUT_TWI
+static uint8_t  twi_dirty = 0;  // Bit per group
+static uint8_t  twi_idx = LOCAL_OUT_GROUPS_MAX; // Group being written. LOCAL_OUT_GROUPS_MAX if idle
+static uint8_t  twi_buf;
+static uint16_t twi_errors = 0;
+#endif
+
+
+static const FLASHMEM local_out_table_t *entry(uint8_t idx)
+{
+    return &__loconet_localouttable_start + idx;
+}
+
+static uint8_t out_value(uint8_t idx)
+{
+    const FLASHMEM local_out_table_t *p = entry(idx);
+
+    return (p->flags & LOCAL_OUT_INVERT) ? ~out_state[idx] : out_state[idx];
+}
+
+#if LOCAL_OUT_SR_BYTES > 0
+
+static void sr_shift(void)
+{
+    uint8_t         i, bit, val;
+
+    // Last byte in chain goes first. MSB first
+    for (i = LOCAL_OUT_SR_BYTES; i--;)
+    {
+        val = sr_buf[i];
+        for (bit = 0; bit < 8; bit++, val <<= 1)
+        {
+            if (val & 0x80)
+                LOCAL_OUT_SR_VPORT.OUT |= LOCAL_OUT_SR_DATA_bm;
+            else
+                LOCAL_OUT_SR_VPORT.OUT &= ~LOCAL_OUT_SR_DATA_bm;
+            LOCAL_OUT_SR_VPORT.OUT |= LOCAL_OUT_SR_CLK_bm;
+            LOCAL_OUT_SR_VPORT.OUT &= ~LOCAL_OUT_SR_CLK_bm;
+        }
+    }
+    LOCAL_OUT_SR_VPORT.OUT |= LOCAL_OUT_SR_LATCH_bm;
+    LOCAL_OUT_SR_VPORT.OUT &= ~LOCAL_OUT_SR_LATCH_bm;
+}
+
+#endif
+
+static void group_write(uint8_t idx)
+{
+    const FLASHMEM local_out_table_t *p = entry(idx);
+    uint8_t         mask = p->mask;
+    uint8_t         val = out_value(idx) & mask;
+
+    switch (p->type)
+    {
+    case LOCAL_OUT_TYPE_GPIO:
+        p->port->OUTSET = val;
+        p->port->OUTCLR = mask & ~val;
+        break;
+
+#if LOCAL_OUT_SR_BYTES > 0
+    case LOCAL_OUT_TYPE_SR:
+        if (p->num < LOCAL_OUT_SR_BYTES)
+        {
+            sr_buf[p->num] = (sr_buf[p->num] & ~mask) | val;
+            sr_shift();
+        }
+        break;
+#endif
+
+#ifdef LOCAL_OUT_TWI
+    case LOCAL_OUT_TYPE_I2C:
+        twi_dirty |= 1 << idx;
+        break;
+#endif
+
+    default:
+        break;
+    }
+}
+
+
+#ifdef LOCAL_OUT_TWI
+
+static void twi_write_cb(twim_status_t ts)
+{
+    if (ts != TWIM_STATUS_DONE)
+    {
+        twi_errors++;
+        twi_dirty |= 1 << twi_idx;      // Try again
+    }
+    twi_idx = LOCAL_OUT_GROUPS_MAX;
+}
+
+static void twi_next(void)
+{
+    uint8_t         idx;
+
+    for (idx = 0; idx < group_cnt; idx++)
+    {
+        if (twi_dirty & (1 << idx))
+            break;
+    }
+    if (idx >= group_cnt)
+        return;
+
+    // Unused pins are written high, so they can be used as inputs
+    twi_buf = out_value(idx) | ~entry(idx)->mask;
+    if (twim_write(entry(idx)->num, &twi_buf, 1, twi_write_cb))
+    {
+        twi_dirty &= ~(1 << idx);
+        twi_idx = idx;
+    }
+}
+
+#endif
+
+
+void local_out_init(void)
+{
+    const FLASHMEM local_out_table_t *p;
+    uint8_t         i;
+
+    group_cnt = &__loconet_localouttable_end - &__loconet_localouttable_start;
+    if (group_cnt > LOCAL_OUT_GROUPS_MAX)
+    {
+        printf_P(PSTR("ERROR: Too many local output groups: %u\n"), group_cnt);
+        group_cnt = LOCAL_OUT_GROUPS_MAX;
+    }
+
+#if LOCAL_OUT_SR_BYTES > 0
+    LOCAL_OUT_SR_VPORT.OUT &= ~(LOCAL_OUT_SR_DATA_bm | LOCAL_OUT_SR_CLK_bm | LOCAL_OUT_SR_LATCH_bm);
+    LOCAL_OUT_SR_VPORT.DIR |= LOCAL_OUT_SR_DATA_bm | LOCAL_OUT_SR_CLK_bm | LOCAL_OUT_SR_LATCH_bm;
+#endif
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        out_state[i] = 0;       // R
+        if (p->adr < adr_min)
+            adr_min = p->adr;
+        if (p->adr + 7 > adr_max)
+            adr_max = p->adr + 7;
+        group_write(i);
+        if (p->type == LOCAL_OUT_TYPE_GPIO)
+            p->port->DIRSET = p->mask;
+    }
+}
+
+
+void local_out_update(void)
+{
+#ifdef LOCAL_OUT_TWI
+    if (twi_dirty && twi_idx == LOCAL_OUT_GROUPS_MAX)
+        twi_next();
+#endif
+}
+
+
+bool local_out_set(uint16_t adr, bool dir)
+{
+    const FLASHMEM local_out_table_t *p;
+    uint8_t         i, bit;
+
+    if (adr < adr_min || adr > adr_max)
+        return false;
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        if (adr < p->adr || adr >= p->adr + 8)
+            continue;
+        bit = 1 << (adr - p->adr);
+        if (!(p->mask & bit))
+            continue;
+
+        set_cnt++;
+        if (dir)
+            out_state[i] |= bit;
+        else
+            out_state[i] &= ~bit;
+        group_write(i);
+        sw_handler_set_state(adr, dir);
+        return !(p->flags & LOCAL_OUT_LN);
+    }
+    return false;
+}
+
+
+bool local_out_is_local(uint16_t adr)
+{
+    const FLASHMEM local_out_table_t *p;
+    uint8_t         i;
+
+    if (adr < adr_min || adr > adr_max)
+        return false;
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        if (adr >= p->adr && adr < p->adr + 8 && (p->mask & (1 << (adr - p->adr))))
+            return true;
+    }
+    return false;
+}
+
+
+void local_out_sync_state(void)
+{
+    const FLASHMEM local_out_table_t *p;
+    uint8_t         i, n;
+
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        for (n = 0; n < 8; n++)
+        {
+            if (p->mask & (1 << n))
+                sw_handler_set_state(p->adr + n, (out_state[i] >> n) & 1);
+        }
+    }
+}
+
+
+static void loutCmd(uint8_t argc, char *argv[])
+{
+    const FLASHMEM local_out_table_t *p;
+    uint8_t         i;
+
+    printf_P(PSTR("Sets: %u\n"), set_cnt);
+#ifdef LOCAL_OUT_TWI
+    printf_P(PSTR("TWI errors: %u\n"), twi_errors);
+#endif
+    for (i = 0; i < group_cnt; i++)
+    {
+        p = entry(i);
+        switch (p->type)
+        {
+        case LOCAL_OUT_TYPE_GPIO:
+            printf_P(PSTR("%u: Port  %c   "), i, 'A' + (p->port - &PORTA));
+            break;
+        case LOCAL_OUT_TYPE_SR:
+            printf_P(PSTR("%u: SR    %-4u"), i, p->num);
+            break;
+        default:
+            printf_P(PSTR("%u: I2C   0x%02X"), i, p->num);
+            break;
+        }
+        printf_P(PSTR(" adr %4u-%4u mask %02X G %02X%S\n"), p->adr, p->adr + 7, p->mask,
+                 out_state[i] & p->mask, (p->flags & LOCAL_OUT_LN) ? PSTR(" LN") : PSTR(""));
+    }
+}
+
+CMD(lout, "Local outputs");
@@ -0,0 +1,127 @@
+/*
+ * local_out.h
+ *
+ * Local outputs for signals (or anything else), addressed like switches.
+ * Drives AVR port pins, a 74HC595 shift register chain or I2C port
+ * expanders (PCF8574 type) directly, without going through Loconet.
+ *
+ * Created: 19-10-2026 17:11:26
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef LOCAL_OUT_H_
+#define LOCAL_OUT_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOCAL_OUT_INVERT    0x01        // Output is low when G
+#define LOCAL_OUT_LN        0x02        // Also send switch request on Loconet
+
+#define LOCAL_OUT_TYPE_GPIO 0
+#define LOCAL_OUT_TYPE_SR   1
+#define LOCAL_OUT_TYPE_I2C  2
+
+typedef struct
+{
+    PORT_t         *const port;         // Port. NULL if not GPIO
+    const uint8_t   type;
+    const uint8_t   num;                // Shift register byte index or I2C address (8-bit, already left-shifted)
+    const uint8_t   mask;               // Pins in use
+    const uint8_t   flags;
+    const uint16_t  adr;                // Switch address of pin 0
+} local_out_table_t;
+
+/**
+ * Local port output macro.
+ *
+ * Pin n of the port is switch address adr + n.
+ * Outputs are R (low if not inverted) at startup.
+ *
+ * @param p Port letter (A, B, C...).
+ * @param m Mask of pins in use.
+ * @param a Switch address of pin 0.
+ * @param f Flags. LOCAL_OUT_INVERT and/or LOCAL_OUT_LN, or 0.
+ */
+#define LOCAL_OUT_GPIO(p, m, a, f) static const local_out_table_t localoutgpio##p##a \
+    __attribute__((used, section("loconet.localouttable"))) = \
+    {.port = &PORT##p, .type = LOCAL_OUT_TYPE_GPIO, .num = 0, .mask = m, .flags = f, .adr = a};
+
+/**
+ * Local shift register output macro.
+ *
+ * Requires LOCAL_OUT_SR_BYTES, LOCAL_OUT_SR_VPORT and the pin defines to be set.
+ * Byte 0 is the shift register nearest the AVR.
+ * Bit n of the byte is switch address adr + n.
+ *
+ * @param b Byte index in shift register chain.
+ * @param m Mask of bits in use.
+ * @param a Switch address of bit 0.
+ * @param f Flags. LOCAL_OUT_INVERT and/or LOCAL_OUT_LN, or 0.
+ */
+#define LOCAL_OUT_SR(b, m, a, f) static const local_out_table_t localoutsr##b##a \
+    __attribute__((used, section("loconet.localouttable"))) = \
+    {.port = NULL, .type = LOCAL_OUT_TYPE_SR, .num = b, .mask = m, .flags = f, .adr = a};
+
+/**
+ * Local I2C port expander output macro.
+ *
+ * Requires LOCAL_OUT_TWI to be defined.
+ * Bit n of the port expander is switch address adr + n.
+ *
+ * @param t I2C address (8-bit, already left-shifted).
+ * @param m Mask of bits in use.
+ * @param a Switch address of bit 0.
+ * @param f Flags. LOCAL_OUT_INVERT and/or LOCAL_OUT_LN, or 0.
+ */
+#define LOCAL_OUT_I2C(t, m, a, f) static const local_out_table_t localouti2c##t##a \
+    __attribute__((used, section("loconet.localouttable"))) = \
+    {.port = NULL, .type = LOCAL_OUT_TYPE_I2C, .num = t, .mask = m, .flags = f, .adr = a};
+
+
+/**
+ * Init local output module.
+ *
+ * Call once at startup.
+ */
+extern void     local_out_init(void);
+
+/**
+ * Update local output module.
+ *
+ * Call regularly from mainloop.
+ */
+extern void     local_out_update(void);
+
+/**
+ * Set local output.
+ *
+ * Port and shift register outputs are set immediately,
+ * I2C outputs are written from local_out_update().
+ * The switch state in sw_handler is updated too.
+ *
+ * @param adr Switch address.
+ * @param dir True if G, false if R.
+ * @return True if handled locally and no Loconet packet is needed.
+ */
+extern bool     local_out_set(uint16_t adr, bool dir);
+
+/**
+ * Check if switch address is a local output.
+ *
+ * @param adr Switch address.
+ * @return True if address is driven by a local output, also if it has LOCAL_OUT_LN.
+ */
+extern bool     local_out_is_local(uint16_t adr);
+
+/**
+ * Write the states of the local outputs to sw_handler.
+ *
+ * The outputs are R at startup, but sw_handler restores the switch states
+ * from EERAM. Call after the restore, so the states match the outputs.
+ */
+extern void     local_out_sync_state(void);
+
+#endif /* LOCAL_OUT_H_ */
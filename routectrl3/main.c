@@ -7,9 +7,15 @@
 
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include "bus_load.h"
 #include "collision_check.h"
+#include "local_fb.h"
+#include "local_out.h"
 #include "mmi.h"
+#include "perf.h"
+#include "reflex.h"
 #include "route.h"
+#include "statestream.h"
 #include "sw_handler.h"
 #include "switch_queue.h"
 #include "term.h"
@@ -18,14 +24,20 @@
 #include "lib/loconet-avrda/hal_ln.h"
 #include "lib/loconet-avrda/ln_rx.h"
 
+#if defined(EERAM) || defined(LOCAL_FB_TWI) || defined(LOCAL_OUT_TWI)
+#include "twim.h"
+#endif
 #ifdef EERAM
 #include "eeram.h"
-#include "twim.h"
 #endif
 
 __attribute__((OS_main))
 int main(void)
 {
+#ifdef PERF_ROUTE_TIMING
+    hrticks_t       hr;
+#endif
+
 #ifdef EXTXTAL
     // Enable 32.768 kHz crystal oscillator
     _PROTECTED_WRITE(CLKCTRL.XOSC32KCTRLA,
@@ -47,33 +59,52 @@ int main(void)
 
     term_init();
     ticks_init();
-#ifdef EERAM
+    timer_init();
+#if defined(EERAM) || defined(LOCAL_FB_TWI) || defined(LOCAL_OUT_TWI)
     twim_init();
+#endif
+#ifdef EERAM
     eeram_init();
 #endif
     hal_ln_init();
     ln_rx_init();
     collision_check_init();
     mmi_init();
+    local_fb_init();
+    local_out_init();
     route_init();
 
     sei();
 
     while (1)
     {
+        ticks_update();
         term_update();
-#ifdef EERAM
+#if defined(EERAM) || defined(LOCAL_FB_TWI) || defined(LOCAL_OUT_TWI)
         twim_update();
+#endif
+#ifdef EERAM
         eeram_update();
 #endif
         hal_ln_update();
         ln_rx_update();
+        local_fb_update();
+        local_out_update();
+        reflex_update();
         timer_update();
         collision_check_update();
+        bus_load_update();
         switch_queue_update();
         sw_handler_update();
         mmi_update();
+#ifdef PERF_ROUTE_TIMING
+        hr = ticks_hr_get();
+        route_update();
+        perf_record(PERF_ROUTE_UPDATE, ticks_hr_elapsed(hr));
+#else
         route_update();
+#endif
+        statestream_update();
     }
 
     __builtin_unreachable();
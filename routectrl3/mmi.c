@@ -65,27 +65,27 @@ static void led_update(void)
     default:
         PORTC.OUTSET = PIN6_bm;
         count = 0;
-        time = ticks_get();
+        time = ticks_now();
         led_state = LED_OFF;
         break;
 
     case LED_INIT:
-        time = ticks_get();
+        time = ticks_now();
         led_state = LED_DO_INIT;
         break;
 
     case LED_DO_INIT:
-        if (ticks_elapsed(time) >= LED_ON_TICKS)
+        if (ticks_now_elapsed(time) >= LED_ON_TICKS)
         {
             PORTC.OUTTGL = PIN6_bm;
-            time = ticks_get();
+            time = ticks_now();
         }
         break;
 
     case LED_OFF:
-        if (ticks_elapsed(time) >= LED_OFF_TICKS)
+        if (ticks_now_elapsed(time) >= LED_OFF_TICKS)
         {
-            time = ticks_get();
+            time = ticks_now();
             if (count < operating_level)
             {
                 PORTC.OUTCLR = PIN6_bm;
@@ -99,9 +99,9 @@ static void led_update(void)
         break;
 
     case LED_ON:
-        if (ticks_elapsed(time) >= LED_ON_TICKS)
+        if (ticks_now_elapsed(time) >= LED_ON_TICKS)
         {
-            time = ticks_get();
+            time = ticks_now();
             PORTC.OUTSET = PIN6_bm;
             led_state = LED_OFF;
             count++;
@@ -109,9 +109,9 @@ static void led_update(void)
         break;
 
     case LED_DELAY:
-        if (ticks_elapsed(time) >= LED_DELAY_TICKS)
+        if (ticks_now_elapsed(time) >= LED_DELAY_TICKS)
         {
-            time = ticks_get();
+            time = ticks_now();
             led_state = LED_OFF;
             count = 0;
         }
@@ -131,7 +131,7 @@ static void button_update(void)
     default:
         if (!(PORTC.IN & PIN7_bm))
         {
-            time = ticks_get();
+            time = ticks_now();
             state = BUTTON_ACTIVE_DEBOUNCE;
         }
         break;
@@ -141,7 +141,7 @@ static void button_update(void)
         {
             state = BUTTON_IDLE;
         }
-        else if (ticks_elapsed(time) >= BUTTON_DEBOUNCE_TICKS)
+        else if (ticks_now_elapsed(time) >= BUTTON_DEBOUNCE_TICKS)
         {
             state = BUTTON_ACTIVE;
             operating_level++;
@@ -154,7 +154,7 @@ static void button_update(void)
     case BUTTON_ACTIVE:
         if (PORTC.IN & PIN7_bm)
         {
-            time = ticks_get();
+            time = ticks_now();
             state = BUTTON_IDLE_DEBOUNCE;
         }
         break;
@@ -164,7 +164,7 @@ static void button_update(void)
         {
             state = BUTTON_ACTIVE;
         }
-        else if (ticks_elapsed(time) >= BUTTON_DEBOUNCE_TICKS)
+        else if (ticks_now_elapsed(time) >= BUTTON_DEBOUNCE_TICKS)
         {
             state = BUTTON_IDLE;
         }
@@ -0,0 +1,155 @@
+/*
+ * perf.c
+ *
+ * Firmware performance counters.
+ *
+ * Free RAM between heap and stack is painted with a pattern before main()
+ * runs. The lowest overwritten byte gives the peak stack use.
+ *
+ * 'bench' runs the core table primitives against the linked-in tables,
+ * to compare toolchains (linear or binary search) and table layouts.
+ *
+ * Created: 19-10-2026 19:27:04
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fb_handler.h"
+#include "perf.h"
+#include "route.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#define STACK_PAINT 0xc5
+
+#ifndef PERF_BENCH_N
+#define PERF_BENCH_N 1000
+#endif
+
+typedef struct
+{
+    uint32_t        cnt;
+    uint32_t        sum;
+    hrticks_t       max;
+} perf_stat_t;
+
+extern uint8_t  __heap_start;
+extern char    *__brkval;
+
+static perf_stat_t stat[PERF_CNT];
+
+
+// Runs before .data and .bss are initialized. Stack is not set up for C use, so keep it simple
+__attribute__((naked, used, section(".init1")))
+static void stack_paint(void)
+{
+    __asm__ __volatile__("    ldi r30, lo8(__heap_start)\n"
+                         "    ldi r31, hi8(__heap_start)\n"
+                         "    ldi r24, %0\n"
+                         "    ldi r25, hi8(%1)\n"
+                         "1:  st  Z+, r24\n"
+                         "    cpi r30, lo8(%1)\n"
+                         "    cpc r31, r25\n"
+                         "    brlo 1b\n"
+                         "    breq 1b\n"
+                         ::"i"(STACK_PAINT), "i"(RAMEND)
+                         :"r24", "r25", "r30", "r31", "memory");
+}
+
+
+uint16_t perf_stack_peak(void)
+{
+    const uint8_t  *p = __brkval ? (const uint8_t *)__brkval : &__heap_start;
+
+    // Skip heap, then find first byte written by the stack
+    while (p <= (const uint8_t *)RAMEND && *p == STACK_PAINT)
+        p++;
+    return RAMEND + 1 - (uint16_t)p;
+}
+
+
+void perf_record(perf_id_t id, hrticks_t cycles)
+{
+    perf_stat_t    *s = &stat[id];
+
+    s->cnt++;
+    s->sum += cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+}
+
+
+static void print_stat(const char *name, const perf_stat_t *s)
+{
+    printf_P(PSTR("%S %8lu %8lu %8lu\n"), name, s->cnt, s->cnt ? s->sum / s->cnt : 0, s->max);
+}
+
+static void perfCmd(uint8_t argc, char *argv[])
+{
+    if (argc >= 2 && argv[1][0] == 'r')
+    {
+        memset(stat, 0, sizeof(stat));
+        return;
+    }
+
+    printf_P(PSTR("Stack peak: %u bytes\n"), perf_stack_peak());
+    printf_P(PSTR("Measured        count   avg cyc  max cyc\n"));
+    print_stat(PSTR("INPUT_REP   "), &stat[PERF_DISPATCH_FB]);
+    print_stat(PSTR("SW_REQ      "), &stat[PERF_DISPATCH_SW]);
+#ifdef PERF_ROUTE_TIMING
+    print_stat(PSTR("route_update"), &stat[PERF_ROUTE_UPDATE]);
+#endif
+}
+
+CMD(perf, "Performance counters. 'perf r' resets");
+
+
+static hrticks_t bench_loop(uint16_t n)
+{
+    volatile uint16_t sink;
+    hrticks_t       t0;
+
+    t0 = ticks_hr_get();
+    while (n--)
+        sink = n;
+    (void)sink;
+
+    return ticks_hr_elapsed(t0);
+}
+
+static void print_bench(const char *name, hrticks_t cycles, uint16_t n)
+{
+    uint32_t        per = cycles / n;
+    uint32_t        us10 = HRTICKS_TO_US(per * 10);
+
+    printf_P(PSTR("%S %8lu %6lu.%lu\n"), name, per, us10 / 10, us10 % 10);
+}
+
+static void benchCmd(uint8_t argc, char *argv[])
+{
+    uint16_t        n = PERF_BENCH_N;
+
+    if (argc >= 2)
+        n = strtoul(argv[1], NULL, 0);
+    if (n == 0)
+        return;
+
+#if __GNUC__ < 15
+    printf_P(PSTR("Linear table search, %u calls\n"), n);
+#else
+    printf_P(PSTR("Binary table search, %u calls\n"), n);
+#endif
+    printf_P(PSTR("Primitive          cyc/call  us/call\n"));
+    print_bench(PSTR("loop overhead   "), bench_loop(n), n);
+    print_bench(PSTR("getrouteentry   "), route_bench(ROUTE_BENCH_LOOKUP, n), n);
+    print_bench(PSTR("checkconstraints"), route_bench(ROUTE_BENCH_CSTR, n), n);
+    print_bench(PSTR("route table read"), route_bench(ROUTE_BENCH_FLASH, n), n);
+    print_bench(PSTR("feedback search "), fb_handler_bench(n), n);
+}
+
+CMD(bench, "Benchmark table primitives. bench [calls]");
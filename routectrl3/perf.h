@@ -0,0 +1,42 @@
+/*
+ * perf.h
+ *
+ * Firmware performance counters.
+ * Peak stack use (stack painting), Loconet packet dispatch cost
+ * and update function cost.
+ *
+ * Created: 19-10-2026 19:26:50
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <stdint.h>
+#include "ticks.h"
+
+typedef enum
+{
+    PERF_DISPATCH_FB,           // OPC_INPUT_REP dispatch
+    PERF_DISPATCH_SW,           // OPC_SW_REQ dispatch
+    PERF_ROUTE_UPDATE,          // route_update(). Only measured with PERF_ROUTE_TIMING defined
+    PERF_CNT
+} perf_id_t;
+
+/**
+ * Record cost of a measured function.
+ *
+ * @param id     What was measured.
+ * @param cycles Cycles spent (hrticks).
+ */
+extern void     perf_record(perf_id_t id, hrticks_t cycles);
+
+/**
+ * Get peak stack use since startup.
+ *
+ * @return Bytes of RAM used by the stack.
+ */
+extern uint16_t perf_stack_peak(void);
+
+#endif /* PERF_H_ */
@@ -0,0 +1,269 @@
+/*
+ * reflex.c
+ *
+ * Reflex table. Sets a switch/signal directly when a feedback is received.
+ *
+ * Each reflex uses a slot that sends the switch request (on) right away,
+ * and the off request after the usual switch active time. If the Loconet
+ * TX buffer is full, or the request fails on the bus, it is retried from
+ * reflex_update(). A lost off would leave the accessory output on.
+ * Older commands for the same address still queued by routes are dropped,
+ * so they can't undo the reflex.
+ * Latency from feedback received to switch request sent is measured.
+ *
+ * Created: 19-10-2026 18:03:02
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bus_load.h"
+#include "capture.h"
+#include "flashmem.h"
+#include "latency.h"
+#include "local_out.h"
+#include "reflex.h"
+#include "route.h"
+#include "sw_handler.h"
+#include "ticks.h"
+#include "lib/avr-shell-cmd/cmd.h"
+#include "lib/loconet-avrda/ln_tx.h"
+
+#define SWITCH_ACTIVE_TIME  TICKS_FROM_MS(327)
+#define SLOT_CNT            4
+
+typedef enum
+{
+    SLOT_FREE,
+    SLOT_ON,                    // On request to be sent
+    SLOT_ON_WAIT_CB,
+    SLOT_ACTIVE,
+    SLOT_OFF,                   // Off request to be sent
+    SLOT_OFF_WAIT_CB
+} slot_state_t;
+
+typedef struct
+{
+    slot_state_t    state;
+    uint16_t        adr;
+    bool            dir;
+    hrticks_t       rx;         // Time feedback was received
+    ticks_t         sent;       // Time on request was sent
+    latency_cause_t cause;
+} slot_t;
+
+extern const FLASHMEM reflex_table_t __loconet_reflextable_start;
+extern const FLASHMEM reflex_table_t __loconet_reflextable_end;
+
+static slot_t   slot[SLOT_CNT];
+static uint16_t reflex_cnt = 0;
+static uint16_t reflex_overrun = 0;
+static uint16_t tx_fail = 0;
+static uint16_t lat_cnt = 0;
+static uint32_t lat_sum = 0;   // us
+static uint32_t lat_min = UINT32_MAX;
+static uint32_t lat_max = 0;
+
+
+static void reflex_latency(hrticks_t rx)
+{
+    uint32_t        us = HRTICKS_TO_US(ticks_hr_elapsed(rx));
+
+    if (lat_cnt == UINT16_MAX)
+        return;
+    lat_cnt++;
+    lat_sum += us;
+    if (us < lat_min)
+        lat_min = us;
+    if (us > lat_max)
+        lat_max = us;
+}
+
+static void sw_cb(void *ctx, hal_ln_result_t res)
+{
+    slot_t         *s = ctx;
+
+    if (res != HAL_LN_SUCCESS)
+    {
+        // Unable to transmit. Send again from reflex_update()
+        if (tx_fail < UINT16_MAX)
+            tx_fail++;
+        s->state = s->state == SLOT_ON_WAIT_CB ? SLOT_ON : SLOT_OFF;
+        return;
+    }
+
+#ifndef LNECHO
+    bus_load_tx();
+#endif
+    if (s->state == SLOT_ON_WAIT_CB)
+    {
+        reflex_latency(s->rx);
+        latency_record(s->adr, s->cause);
+        s->sent = ticks_now();  // Same clock as reflex_update() compares with
+        s->state = SLOT_ACTIVE;
+#ifndef LNECHO
+        // Update switch state (only needed if not receiving own LN echo).
+        sw_handler_set_state(s->adr, s->dir);
+#endif
+    }
+    else
+    {
+        s->state = SLOT_FREE;
+    }
+}
+
+static void slot_send(slot_t *s)
+{
+    bool            on = s->state == SLOT_ON;
+
+    if (ln_tx_opc_sw_req(s->adr, s->dir, on, sw_cb, s) == 0)
+    {
+        capture_put(CAPTURE_TX_SW, s->adr, (s->dir ? 1 : 0) | (on ? 2 : 0));
+        s->state = on ? SLOT_ON_WAIT_CB : SLOT_OFF_WAIT_CB;
+    }
+}
+
+static void reflex_exec(const FLASHMEM reflex_table_t *p, hrticks_t rx)
+{
+    slot_t         *s;
+    uint8_t         i;
+
+    reflex_cnt++;
+    route_send_drop(p->swadr);
+
+    if (local_out_set(p->swadr, p->dir))
+    {
+        reflex_latency(rx);
+        latency_record(p->swadr, latency_cause_get());
+        return;
+    }
+
+    for (i = 0, s = slot; i < SLOT_CNT; i++, s++)
+    {
+        if (s->state == SLOT_FREE)
+        {
+            s->adr = p->swadr;
+            s->dir = p->dir;
+            s->rx = rx;
+            s->cause = latency_cause_get();
+            s->state = SLOT_ON;
+            slot_send(s);
+            return;
+        }
+    }
+    reflex_overrun++;
+}
+
+
+#if __GNUC__ < 15
+// Old compiler probably means old linker. Use linear search as table isn't numerically sorted
+
+void reflex_input(uint16_t adr, bool l)
+{
+    const FLASHMEM reflex_table_t *p = &__loconet_reflextable_start;
+    hrticks_t       rx = ticks_hr_get();
+
+    while (p < &__loconet_reflextable_end)
+    {
+        if (p->fbadr == adr && p->occ == l)
+            reflex_exec(p, rx);
+        p++;
+    }
+}
+
+#else
+// Linker has sorted the table numerically. Use binary search
+
+void reflex_input(uint16_t adr, bool l)
+{
+    const FLASHMEM reflex_table_t *p, *pend;
+    uint16_t        low, high, mid;
+    hrticks_t       rx = ticks_hr_get();
+
+    p = &__loconet_reflextable_start;
+    pend = &__loconet_reflextable_end;
+    low = 0;
+    high = pend - p;
+
+    for (;;)
+    {
+        if (low >= high)
+        {
+            p = p + low;
+            break;
+        }
+        mid = low + ((high - low) >> 1);
+        if ((p + mid)->fbadr < adr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    while (p < pend && p->fbadr == adr)
+    {
+        if (p->occ == l)
+            reflex_exec(p, rx);
+        p++;
+    }
+}
+
+#endif
+
+
+void reflex_update(void)
+{
+    slot_t         *s;
+    uint8_t         i;
+
+    for (i = 0, s = slot; i < SLOT_CNT; i++, s++)
+    {
+        switch (s->state)
+        {
+        case SLOT_ON:
+        case SLOT_OFF:
+            slot_send(s);
+            break;
+
+        case SLOT_ACTIVE:
+            if (ticks_now_elapsed(s->sent) >= SWITCH_ACTIVE_TIME)
+            {
+                s->state = SLOT_OFF;
+                slot_send(s);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+static void reflexCmd(uint8_t argc, char *argv[])
+{
+    if (argc >= 2 && argv[1][0] == 'r')
+    {
+        reflex_cnt = 0;
+        reflex_overrun = 0;
+        tx_fail = 0;
+        lat_cnt = 0;
+        lat_sum = 0;
+        lat_min = UINT32_MAX;
+        lat_max = 0;
+        return;
+    }
+
+    printf_P(PSTR("Entries:  %u\n"), (uint16_t)(&__loconet_reflextable_end - &__loconet_reflextable_start));
+    printf_P(PSTR("Executed: %u\n"), reflex_cnt);
+    printf_P(PSTR("No slot:  %u\n"), reflex_overrun);
+    printf_P(PSTR("TX fail:  %u\n"), tx_fail);
+    if (lat_cnt)
+        printf_P(PSTR("Latency:  min %lu us, avg %lu us, max %lu us (%u sent)\n"), lat_min, lat_sum / lat_cnt,
+                 lat_max, lat_cnt);
+}
+
+CMD(reflex, "Reflex table stats. 'reflex r' resets");
@@ -0,0 +1,72 @@
+/*
+ * reflex.h
+ *
+ * Reflex table. Sets a switch/signal directly when a feedback is received,
+ * bypassing routes and all queues. Intended for protective stop signals.
+ *
+ * Created: 19-10-2026 18:02:45
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef REFLEX_H_
+#define REFLEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    const uint16_t  fbadr;
+    const uint16_t  swadr;
+    const bool      occ;
+    const bool      dir;
+} reflex_table_t;
+
+/**
+ * Reflex on feedback occupied macro.
+ *
+ * When the feedback address is reported occupied, the switch request is
+ * sent at once (or the local output is set), ahead of all queues.
+ *
+ * @param fb  Feedback address.
+ * @param sw  Switch address.
+ * @param d   Switch direction. True if G, false if R.
+ */
+#define REFLEX_OCC(fb, sw, d) static const reflex_table_t reflexoccentry##fb##_##sw \
+    __attribute__((used, section("loconet.reflextable." #fb))) = \
+    {.fbadr = fb, .swadr = sw, .occ = true, .dir = d};
+
+/**
+ * Reflex on feedback free macro.
+ *
+ * When the feedback address is reported free, the switch request is
+ * sent at once (or the local output is set), ahead of all queues.
+ *
+ * @param fb  Feedback address.
+ * @param sw  Switch address.
+ * @param d   Switch direction. True if G, false if R.
+ */
+#define REFLEX_FREE(fb, sw, d) static const reflex_table_t reflexfreeentry##fb##_##sw \
+    __attribute__((used, section("loconet.reflextable." #fb))) = \
+    {.fbadr = fb, .swadr = sw, .occ = false, .dir = d};
+
+
+/**
+ * Update reflex module.
+ *
+ * Call regularly from mainloop.
+ */
+extern void     reflex_update(void);
+
+/**
+ * Handle feedback input.
+ *
+ * Called by fb_handler before feedback subscribers.
+ *
+ * @param adr Feedback address.
+ * @param l   True if occupied.
+ */
+extern void     reflex_input(uint16_t adr, bool l);
+
+#endif /* REFLEX_H_ */
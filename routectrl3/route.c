@@ -10,26 +10,89 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "capture.h"
 #include "fb_handler.h"
 #include "flashmem.h"
+#include "latency.h"
+#include "local_out.h"
 #include "route.h"
 #include "route_delay.h"
 #include "route_queue.h"
+#include "statestream.h"
 #include "switch_queue.h"
 #include "ticks.h"
 #include "timer.h"
-#include "lib/loconet-avrda/ln_tx.h"
+#include "trace.h"
 
 
 extern const FLASHMEM route_table_t __loconet_routetable_start;
 extern const FLASHMEM route_table_t __loconet_routetable_end;
 
+// Latency causes of routes requested and activated without waiting. Few
+// routes are between request and activation at a time, so they are kept
+// here and not per route. The oldest is overwritten when full
+#ifndef ROUTE_CAUSE_SLOTS
+#define ROUTE_CAUSE_SLOTS 8
+#endif
+
+// Free route queue space needed to activate a route. Leaves room for the
+// commands of the activation and of routes being freed meanwhile
+#ifndef ROUTE_QUEUE_RESERVE
+#define ROUTE_QUEUE_RESERVE 32
+#endif
+
 typedef struct
 {
     route_state_t   state;
 } routeparm_t;
 
+typedef struct
+{
+    routenum_t      num;
+    latency_cause_t cause;
+} route_cause_t;
+
 static routeparm_t parm[MAXROUTES];
+static route_cause_t cause_slot[ROUTE_CAUSE_SLOTS];
+static uint8_t  cause_next = 0;
+
+
+static void cause_put(routenum_t num, latency_cause_t cause)
+{
+    if (cause == LATENCY_CAUSE_NONE)
+        return;
+    cause_slot[cause_next].num = num;
+    cause_slot[cause_next].cause = cause;
+    if (++cause_next >= ROUTE_CAUSE_SLOTS)
+        cause_next = 0;
+}
+
+static latency_cause_t cause_take(routenum_t num)
+{
+    latency_cause_t cause;
+    uint8_t         i;
+
+    for (i = 0; i < ROUTE_CAUSE_SLOTS; i++)
+    {
+        if (cause_slot[i].cause != LATENCY_CAUSE_NONE && cause_slot[i].num == num)
+        {
+            cause = cause_slot[i].cause;
+            cause_slot[i].cause = LATENCY_CAUSE_NONE;
+            return cause;
+        }
+    }
+    return LATENCY_CAUSE_NONE;
+}
+
+
+static void set_state(routenum_t num, route_state_t state)
+{
+    if (parm[num].state != state)
+    {
+        parm[num].state = state;
+        statestream_route(num, state);
+    }
+}
 
 
 #if __GNUC__ < 15
@@ -125,6 +188,7 @@ static bool checkconstraints(const FLASHMEM route_table_t * rc)
 
 void route_init(void)
 {
+    route_delay_init();
 }
 
 void route_update(void)
@@ -133,7 +197,6 @@ void route_update(void)
     const FLASHMEM route_table_t *p;
 
     // Update sub-includes
-    route_delay_update();
     route_queue_update();
 
     // Check one route per update
@@ -164,15 +227,18 @@ void route_update(void)
         return;
     }
 
-    // Activate route
-    parm[num].state = ROUTE_ACTIVE;
+    // Activate route, when its commands fit in the route queue
+    if (route_queue_free() < ROUTE_QUEUE_RESERVE)
+        return;
+    set_state(num, ROUTE_ACTIVE);
     if (p)
     {
-#ifdef ROUTE_DEBUG
-        printf_P(PSTR("Route %u activate\n"), num);
-#endif
+        latency_cause_t prev = latency_cause_set(cause_take(num));
+
+        TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_ACTIVATE, num, 0);
         if (p->activateroute)
             p->activateroute();
+        latency_cause_set(prev);
     }
     else
     {
@@ -193,18 +259,23 @@ void route_request(routenum_t num)
     if (parm[num].state != ROUTE_FREE)
         return;
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u request\n"), num);
-#endif
+    TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_REQUEST, num, 0);
 
     // Check constraints
     p = getrouteentry(num);
     if (p)
     {
+        cause_take(num);        // Stale, if freed before activation
         if (checkconstraints(p))
-            parm[num].state = ROUTE_AWAITEXE;
+        {
+            cause_put(num, latency_cause_get());
+            set_state(num, ROUTE_AWAITEXE);
+        }
         else
-            parm[num].state = ROUTE_AWAITCSTR;
+        {
+            // Latency would mostly be waiting time. Don't measure
+            set_state(num, ROUTE_AWAITCSTR);
+        }
     }
     else
     {
@@ -225,11 +296,9 @@ void route_free(routenum_t num)
     if (parm[num].state != ROUTE_ACTIVE)
         return;
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u free\n"), num);
-#endif
+    TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_FREE, num, 0);
 
-    parm[num].state = ROUTE_FREE;
+    set_state(num, ROUTE_FREE);
     p = getrouteentry(num);
     if (p)
     {
@@ -252,12 +321,8 @@ void route_cancel(routenum_t num)
         return;
     }
 
-#ifdef ROUTE_DEBUG
     if (parm[num].state != ROUTE_FREE)
-    {
-        printf_P(PSTR("Route %u cancel\n"), num);
-    }
-#endif
+        TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_CANCEL, num, 0);
 
     if (parm[num].state == ROUTE_ACTIVE)
     {
@@ -273,7 +338,7 @@ void route_cancel(routenum_t num)
         }
     }
 
-    parm[num].state = ROUTE_FREE;
+    set_state(num, ROUTE_FREE);
 }
 
 void route_forceactive(routenum_t num)
@@ -284,11 +349,9 @@ void route_forceactive(routenum_t num)
         return;
     }
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u force active\n"), num);
-#endif
+    TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_FORCE, num, 0);
 
-    parm[num].state = ROUTE_ACTIVE;
+    set_state(num, ROUTE_ACTIVE);
 }
 
 void route_kill(routenum_t num)
@@ -299,11 +362,9 @@ void route_kill(routenum_t num)
         return;
     }
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u kill\n"), num);
-#endif
+    TRACE(TRACE_MOD_ROUTE, TRACE_INFO, TRACE_EV_ROUTE_KILL, num, 0);
 
-    parm[num].state = ROUTE_FREE;
+    set_state(num, ROUTE_FREE);
 }
 
 route_state_t route_state(routenum_t num)
@@ -321,14 +382,31 @@ bool route_exists(routenum_t num)
 
 void route_send_sw(uint16_t adr, bool opt)
 {
+    // A local R is set at once, and an older G still in the queue must not undo it.
+    // G waits in the queue behind the switches of the route
+    if (!opt && local_out_is_local(adr))
+    {
+        route_send_drop(adr);
+        if (local_out_set(adr, opt))
+        {
+            latency_record(adr, latency_cause_get());
+            return;
+        }
+        // LOCAL_OUT_LN: The R is queued for the Loconet mirror only
+    }
+
     route_queue_add(adr, opt, RQ_CMD_SW);
 }
 
 void route_send_sw_prio(uint16_t adr, bool opt)
 {
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Send SW %u %c\n"), adr, opt ? 'G' : 'R');
-#endif
+    if (local_out_set(adr, opt))
+    {
+        latency_record(adr, latency_cause_get());
+        return;
+    }
+
+    TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_DEBUG, TRACE_EV_SEND_SW_PRIO, adr, opt);
 
     switch_queue_add(adr, opt);
 }
@@ -340,14 +418,70 @@ void route_send_fb(uint16_t adr, bool opt)
 
 void route_send_fb_prio(uint16_t adr, bool opt)
 {
-    ln_tx_opc_input_rep(adr, opt, NULL, NULL);
+    if (latency_tx_input_rep(adr, opt, latency_cause_get()) == 0)
+        capture_put(CAPTURE_TX_FB, adr, opt);
 
 #ifndef LNECHO
     // Update fb state (only needed if not receiving own LN echo).
     fb_handler_set_state(adr, opt);
 #endif
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Send FB %u %S\n"), adr, opt ? PSTR("OCCUPIED") : PSTR("FREE"));
-#endif
+    TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_DEBUG, TRACE_EV_SEND_FB_PRIO, adr, opt);
+}
+
+void route_send_drop(uint16_t adr)
+{
+    route_queue_drop_sw(adr);
+    switch_queue_drop(adr);
+}
+
+uint16_t route_send_stat(uint8_t *peak)
+{
+    return route_queue_stat(peak);
+}
+
+hrticks_t route_bench(route_bench_t what, uint16_t n)
+{
+    const FLASHMEM route_table_t *p = &__loconet_routetable_start;
+    volatile uint16_t sink;
+    routenum_t      num = 0;
+    hrticks_t       t0;
+
+    if (p == &__loconet_routetable_end)
+        return 0;
+
+    t0 = ticks_hr_get();
+    switch (what)
+    {
+    case ROUTE_BENCH_LOOKUP:
+        // All route numbers, also the ones without a route
+        while (n--)
+        {
+            sink = getrouteentry(num) != NULL;
+            if (++num >= MAXROUTES)
+                num = 0;
+        }
+        break;
+
+    case ROUTE_BENCH_CSTR:
+        while (n--)
+        {
+            sink = checkconstraints(p);
+            if (++p >= &__loconet_routetable_end)
+                p = &__loconet_routetable_start;
+        }
+        break;
+
+    case ROUTE_BENCH_FLASH:
+        while (n--)
+        {
+            sink = p->constraint_cnt;
+            if (++p >= &__loconet_routetable_end)
+                p = &__loconet_routetable_start;
+        }
+        break;
+    }
+    (void)sink;
+
+    return ticks_hr_elapsed(t0);
 }
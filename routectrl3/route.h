@@ -12,6 +12,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "flashmem.h"
+#include "ticks.h"
 #include "timer.h"
 
 
@@ -85,6 +86,13 @@ typedef enum
     ROUTE_ACTIVE
 } route_state_t;
 
+typedef enum
+{
+    ROUTE_BENCH_LOOKUP,         // getrouteentry()
+    ROUTE_BENCH_CSTR,           // checkconstraints()
+    ROUTE_BENCH_FLASH           // Route table read through FLASHMEM pointer
+} route_bench_t;
+
 
 /*
  * Init route module.
@@ -173,6 +181,8 @@ extern bool     route_exists(routenum_t num);
  *
  * Queue up a switch command for sending.
  * Queue is shared between switch cmds and feedback reports.
+ * A local output set to R is set at once, and queued commands for it are
+ * dropped (route_send_drop). G is set when its turn in the queue comes.
  *
  * @param adr Switch address.
  * @param opt Switch direction (SW_R / SW_G).
@@ -210,4 +220,32 @@ extern void     route_send_fb(uint16_t adr, bool opt);
  */
 extern void     route_send_fb_prio(uint16_t adr, bool opt);
 
+/**
+ * Drop queued switch commands for an address.
+ *
+ * Used when a switch/signal is set directly, so an older command still
+ * in the route queue or switch queue does not undo it.
+ *
+ * @param adr Switch address.
+ */
+extern void     route_send_drop(uint16_t adr);
+
+/**
+ * Get route send queue statistics since last call.
+ *
+ * @param peak Returns max number of queued commands.
+ * @return Number of commands dropped because the queue was full.
+ */
+extern uint16_t route_send_stat(uint8_t *peak);
+
+/**
+ * Benchmark a route primitive against the linked-in route table.
+ * Blocks for the whole run.
+ *
+ * @param what Primitive to run.
+ * @param n    Number of calls.
+ * @return     Cycles (hrticks) spent, including loop overhead. 0 if there are no routes.
+ */
+extern hrticks_t route_bench(route_bench_t what, uint16_t n);
+
 #endif /* ROUTE_H_ */
@@ -12,6 +12,43 @@
 #include <stdlib.h>
 #include "lib/avr-shell-cmd/cmd.h"
 #include "route.h"
+#include "term.h"
+
+static uint16_t list_num, list_end;
+
+static bool route_list_cont(void)
+{
+    routenum_t      num = list_num;
+
+    printf_P(PSTR("Route %u: "), num);
+    if (!route_exists(num))
+    {
+        printf_P(PSTR("Undefined\n"));
+    }
+    else
+    {
+        switch (route_state(num))
+        {
+        case ROUTE_FREE:
+            printf_P(PSTR("FREE\n"));
+            break;
+        case ROUTE_AWAITCSTR:
+            printf_P(PSTR("AWAITCSTR\n"));
+            break;
+        case ROUTE_AWAITEXE:
+            printf_P(PSTR("AWAITEXE\n"));
+            break;
+        case ROUTE_ACTIVE:
+            printf_P(PSTR("ACTIVE\n"));
+            break;
+        default:
+            printf_P(PSTR("INVALID\n"));
+            break;
+        }
+    }
+
+    return ++list_num <= list_end;
+}
 
 static void routeCmd(uint8_t argc, char *argv[])
 {
@@ -97,36 +134,12 @@ static void routeCmd(uint8_t argc, char *argv[])
             printf_P(PSTR("Await constraints: %u\n"), cstr);
             printf_P(PSTR("Await execution:   %u\n"), exe);
         }
-        else
+        else if (num <= numto)
         {
-            for (; num <= numto; num++)
-            {
-                printf_P(PSTR("Route %u: "), num);
-                if (!route_exists(num))
-                {
-                    printf_P(PSTR("Undefined\n"));
-                    continue;
-                }
-
-                switch (route_state(num))
-                {
-                case ROUTE_FREE:
-                    printf_P(PSTR("FREE\n"));
-                    break;
-                case ROUTE_AWAITCSTR:
-                    printf_P(PSTR("AWAITCSTR\n"));
-                    break;
-                case ROUTE_AWAITEXE:
-                    printf_P(PSTR("AWAITEXE\n"));
-                    break;
-                case ROUTE_ACTIVE:
-                    printf_P(PSTR("ACTIVE\n"));
-                    break;
-                default:
-                    printf_P(PSTR("INVALID\n"));
-                    break;
-                }
-            }
+            // Listed one route per mainloop iteration
+            list_num = num;
+            list_end = numto;
+            term_continue(route_list_cont);
         }
         break;
 
@@ -1,6 +1,10 @@
 /*
  * route_delay.c
  *
+ * Delays are kept in a static pool and run on the timer wheel.
+ * Pending delays are chained in a small hash on route number, so cancel
+ * only visits a fraction of the delays, without RAM per route.
+ *
  * Created: 27-12-2024 12:41:37
  *  Author: Mikael Ejberg Pedersen
  */
@@ -9,113 +13,139 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include "route.h"
 #include "route_delay.h"
 #include "ticks.h"
+#include "timer.h"
+#include "trace.h"
+
+#if ROUTE_DELAY_POOL_SIZE > 65534
+#error "ROUTE_DELAY_POOL_SIZE too large"
+#endif
 
+#if ROUTE_DELAY_POOL_SIZE > 254
+typedef uint16_t delay_idx_t;
+#define NIL 0xffff
+#else
+typedef uint8_t delay_idx_t;
+#define NIL 0xff
+#endif
 
-typedef struct route_delay_t_
+#define HASH_SIZE       32      // Power of 2
+#define HASH(num)       ((num) & (HASH_SIZE - 1))
+
+typedef struct
 {
-    struct route_delay_t_ *next;
-    ticks_t         timeout;
     route_delay_cb *cb;
+    timer_handle_t  timer;
     routenum_t      routenum;
+    delay_idx_t     next;       // Next delay in same hash chain, or next free
 } route_delay_t;
 
-static route_delay_t *head = NULL;
+static route_delay_t delays[ROUTE_DELAY_POOL_SIZE];
+static delay_idx_t hash_head[HASH_SIZE];
+static delay_idx_t free_head = NIL;
 
 
-void route_delay_add(uint16_t timeout, route_delay_cb *cb, routenum_t num)
+static void delay_free(delay_idx_t i)
 {
-    route_delay_t  *p, *t;
+    delays[i].cb = NULL;
+    delays[i].next = free_head;
+    free_head = i;
+}
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u add delay %u seconds\n"), num, timeout);
-#endif
+static void delay_unlink(delay_idx_t i)
+{
+    delay_idx_t    *p = &hash_head[HASH(delays[i].routenum)];
 
-    t = malloc(sizeof(*t));
-    if (!t)
+    while (*p != NIL)
     {
-        printf_P(PSTR("ERROR: Out of memory\n"));
-        return;
+        if (*p == i)
+        {
+            *p = delays[i].next;
+            return;
+        }
+        p = &delays[*p].next;
     }
+}
 
-    t->timeout = ticks_get() + TICKS_FROM_SEC(timeout);
-    t->cb = cb;
-    t->routenum = num;
+static void delay_timeout(void *ctx)
+{
+    route_delay_t  *d = ctx;
+    route_delay_cb *cb = d->cb;
+    routenum_t      num = d->routenum;
 
-    if (!head)                  // No timers in list
-    {
-        head = t;
-        head->next = NULL;
+    TRACE(TRACE_MOD_ROUTE_DELAY, TRACE_INFO, TRACE_EV_DELAY_TIMEOUT, num, 0);
+
+    delay_unlink(d - delays);
+    delay_free(d - delays);
+
+    // Timeout callback
+    cb(num);
+}
+
+
+void route_delay_init(void)
+{
+    uint16_t        i;
+
+    for (i = 0; i < HASH_SIZE; i++)
+        hash_head[i] = NIL;
+
+    for (i = 0; i < ROUTE_DELAY_POOL_SIZE; i++)
+        delay_free(ROUTE_DELAY_POOL_SIZE - 1 - i);
+}
+
+void route_delay_add(uint16_t timeout, route_delay_cb *cb, routenum_t num)
+{
+    delay_idx_t     i;
+
+    TRACE(TRACE_MOD_ROUTE_DELAY, TRACE_INFO, TRACE_EV_DELAY_ADD, num, timeout);
+
+    if (num >= MAXROUTES)
         return;
-    }
 
-    if (!((head->timeout - timeout) & 0x80000000))
+    i = free_head;
+    if (i == NIL)
     {
-        // New timer is shorter than timer in head. Put new timer first
-        t->next = head;
-        head = t;
+        printf_P(PSTR("ERROR: Out of route delays\n"));
         return;
     }
 
-    p = head;
-    while (p->next)
+    delays[i].timer = timer_add_class(TICKS_FROM_SEC((ticks_t) timeout), delay_timeout, &delays[i],
+                                      TIMER_CLASS_ROUTE_DELAY);
+    if (delays[i].timer == TIMER_HANDLE_INVALID)
     {
-        if (!((p->next->timeout - timeout) & 0x80000000))
-            break;
-        p = p->next;
+        printf_P(PSTR("ERROR: Out of timers\n"));
+        return;
     }
 
-    t->next = p->next;
-    p->next = t;
+    free_head = delays[i].next;
+    delays[i].cb = cb;
+    delays[i].routenum = num;
+    delays[i].next = hash_head[HASH(num)];
+    hash_head[HASH(num)] = i;
 }
 
 void route_delay_cancel(routenum_t num)
 {
-    route_delay_t **p = &head;
+    delay_idx_t    *p, i;
 
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u cancel delay\n"), num);
-#endif
+    TRACE(TRACE_MOD_ROUTE_DELAY, TRACE_INFO, TRACE_EV_DELAY_CANCEL, num, 0);
 
-    while (*p)
-    {
-        if ((*p)->routenum == num)
-        {
-            route_delay_t  *q = *p;
+    if (num >= MAXROUTES)
+        return;
 
-            *p = q->next;
-            free(q);
-        }
-        else
+    p = &hash_head[HASH(num)];
+    while ((i = *p) != NIL)
+    {
+        if (delays[i].routenum != num)
         {
-            p = &((*p)->next);
+            p = &delays[i].next;
+            continue;
         }
+        *p = delays[i].next;
+        timer_cancel(delays[i].timer);
+        delay_free(i);
     }
 }
-
-void route_delay_update(void)
-{
-    route_delay_t  *p;
-
-    if (!head)
-        return;
-
-    if ((ticks_get() - head->timeout) & 0x80000000)
-        return;
-
-    // Remove timer from list
-    p = head;
-    head = head->next;
-
-#ifdef ROUTE_DEBUG
-    printf_P(PSTR("Route %u delay timeout\n"), p->routenum);
-#endif
-
-    // Timeout callback
-    p->cb(p->routenum);
-
-    free(p);
-}
@@ -11,11 +11,24 @@
 #include <stdint.h>
 #include "route.h"
 
+// Max pending delays. 6 bytes of SRAM each (7 if MAXROUTES > 256), and each also takes a timer.
+// Pools above 254 delays use 16 bit indexes
+#ifndef ROUTE_DELAY_POOL_SIZE
+#define ROUTE_DELAY_POOL_SIZE 64
+#endif
+
 /*
  * Route delay callback function prototype.
  */
 typedef void    (route_delay_cb) (routenum_t);
 
+/*
+ * Init route delay module.
+ *
+ * Call once at startup.
+ */
+extern void     route_delay_init(void);
+
 /*
  * Add a delayed execution.
  *
@@ -32,11 +45,4 @@ extern void     route_delay_add(uint16_t timeout, route_delay_cb *cb, routenum_t
  */
 extern void     route_delay_cancel(routenum_t num);
 
-/*
- * Update route delay module.
- *
- * Call regularly from mainloop.
- */
-extern void     route_delay_update(void);
-
 #endif /* ROUTE_DELAY_H_ */
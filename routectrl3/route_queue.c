@@ -7,15 +7,19 @@
 
 #include <avr/pgmspace.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "bus_load.h"
+#include "capture.h"
 #include "fb_handler.h"
+#include "latency.h"
+#include "local_out.h"
 #include "route_queue.h"
 #include "switch_queue.h"
 #include "ticks.h"
-#include "lib/loconet-avrda/ln_tx.h"
+#include "trace.h"
 
-#define CMD_DELAY_TIME      TICKS_FROM_MS(50)
 #define QUEUE_SIZE          128
 
 typedef struct
@@ -23,6 +27,7 @@ typedef struct
     uint16_t        adr:12;
     uint16_t        opt:1;
     uint16_t        cmd:3;
+    latency_cause_t cause;
 } rq_cmd_t;
 
 static rq_cmd_t queue[QUEUE_SIZE];
@@ -30,22 +35,75 @@ static uint8_t  queue_ridx = 0;
 static uint8_t  queue_widx = 0;
 
 static ticks_t  last_activity = 0;
+static uint8_t  queue_peak = 0;
+static uint16_t queue_dropped = 0;
+static bool     queue_full = false;     // Reported, until a command fits again
 
 
 void route_queue_add(uint16_t adr, bool opt, route_queue_cmd_t cmd)
 {
-    // NOTE: There is no buffer full check
+    uint8_t         used = (queue_widx + QUEUE_SIZE - queue_ridx) % QUEUE_SIZE;
+
+    if (used >= QUEUE_SIZE - 1)
+    {
+        if (queue_dropped < UINT16_MAX)
+            queue_dropped++;
+        TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_ERROR, TRACE_EV_RQ_DROP, adr, cmd);
+        if (!queue_full)
+            printf_P(PSTR("ERROR: Route queue full, dropping commands\n"));
+        queue_full = true;
+        return;
+    }
+    queue_full = false;
+    if (used + 1 > queue_peak)
+        queue_peak = used + 1;
+
     queue[queue_widx].adr = adr;
     queue[queue_widx].opt = opt ? 1 : 0;
     queue[queue_widx].cmd = cmd;
+    queue[queue_widx].cause = latency_cause_get();
     queue_widx++;
     if (queue_widx >= QUEUE_SIZE)
         queue_widx = 0;
 }
 
+void route_queue_drop_sw(uint16_t adr)
+{
+    uint8_t         i;
+
+    for (i = queue_ridx; i != queue_widx; i = (i + 1) % QUEUE_SIZE)
+    {
+        if (queue[i].cmd == RQ_CMD_SW && queue[i].adr == adr)
+            queue[i].cmd = RQ_CMD_NONE;
+    }
+}
+
+uint8_t route_queue_free(void)
+{
+    return QUEUE_SIZE - 1 - (queue_widx + QUEUE_SIZE - queue_ridx) % QUEUE_SIZE;
+}
+
+uint16_t route_queue_stat(uint8_t *peak)
+{
+    uint16_t        dropped = queue_dropped;
+
+    *peak = queue_peak;
+    queue_peak = 0;
+    queue_dropped = 0;
+    return dropped;
+}
+
 void route_queue_update(void)
 {
-    if (ticks_elapsed(last_activity) < CMD_DELAY_TIME || queue_ridx == queue_widx)
+    // Dropped commands take no bus time
+    while (queue_ridx != queue_widx && queue[queue_ridx].cmd == RQ_CMD_NONE)
+    {
+        queue_ridx++;
+        if (queue_ridx >= QUEUE_SIZE)
+            queue_ridx = 0;
+    }
+
+    if (ticks_now_elapsed(last_activity) < bus_load_gap() || queue_ridx == queue_widx)
         return;
 
     if (!switch_queue_empty())
@@ -54,33 +112,45 @@ void route_queue_update(void)
     switch (queue[queue_ridx].cmd)
     {
     case RQ_CMD_SW:
-#ifdef ROUTE_DEBUG
-        printf_P(PSTR("Send SW %u %c\n"), queue[queue_ridx].adr, queue[queue_ridx].opt ? 'G' : 'R');
-#endif
-
-        switch_queue_add(queue[queue_ridx].adr, queue[queue_ridx].opt != 0);
-        break;
+        TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_DEBUG, TRACE_EV_SEND_SW, queue[queue_ridx].adr, queue[queue_ridx].opt);
+
+        // A local output is set now, after the switch commands before it have been sent
+        if (local_out_set(queue[queue_ridx].adr, queue[queue_ridx].opt != 0))
+        {
+            latency_record(queue[queue_ridx].adr, queue[queue_ridx].cause);
+            queue_ridx++;
+            if (queue_ridx >= QUEUE_SIZE)
+                queue_ridx = 0;
+            return;             // No bus time used
+        }
+
+        {
+            latency_cause_t prev = latency_cause_set(queue[queue_ridx].cause);
+
+            switch_queue_add(queue[queue_ridx].adr, queue[queue_ridx].opt != 0);
+            latency_cause_set(prev);
+            break;
+        }
 
     case RQ_CMD_FB:
-        if (ln_tx_opc_input_rep(queue[queue_ridx].adr, queue[queue_ridx].opt, NULL, NULL) != 0)
+        if (latency_tx_input_rep(queue[queue_ridx].adr, queue[queue_ridx].opt, queue[queue_ridx].cause) != 0)
             return;             // input_rep failed. Do not advance queue_ridx
+        capture_put(CAPTURE_TX_FB, queue[queue_ridx].adr, queue[queue_ridx].opt);
 
 #ifndef LNECHO
         // Update fb state (only needed if not receiving own LN echo).
         fb_handler_set_state(queue[queue_ridx].adr, queue[queue_ridx].opt != 0);
+        bus_load_tx();
 #endif
 
-#ifdef ROUTE_DEBUG
-        printf_P(PSTR("Send FB %u %S\n"), queue[queue_ridx].adr,
-                 queue[queue_ridx].opt ? PSTR("OCCUPIED") : PSTR("FREE"));
-#endif
+        TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_DEBUG, TRACE_EV_SEND_FB, queue[queue_ridx].adr, queue[queue_ridx].opt);
         break;
 
     default:
         break;
     }
 
-    last_activity = ticks_get();
+    last_activity = ticks_now();
     queue_ridx++;
     if (queue_ridx >= QUEUE_SIZE)
         queue_ridx = 0;
@@ -16,8 +16,9 @@
 
 typedef enum
 {
-    RQ_CMD_SW,
-    RQ_CMD_FB
+    RQ_CMD_SW,                  // Local output or switch request
+    RQ_CMD_FB,
+    RQ_CMD_NONE                 // Dropped
 } route_queue_cmd_t;
 
 
@@ -37,4 +38,26 @@ extern void     route_queue_update(void);
  */
 extern void     route_queue_add(uint16_t adr, bool opt, route_queue_cmd_t cmd);
 
+/**
+ * Drop queued switch commands for an address.
+ *
+ * @param adr Switch address.
+ */
+extern void     route_queue_drop_sw(uint16_t adr);
+
+/**
+ * Get free space in route queue.
+ *
+ * @return Number of commands that can be added.
+ */
+extern uint8_t  route_queue_free(void);
+
+/**
+ * Get route queue statistics since last call.
+ *
+ * @param peak Returns max number of queued commands.
+ * @return Number of commands dropped because the queue was full.
+ */
+extern uint16_t route_queue_stat(uint8_t *peak);
+
 #endif /* ROUTE_QUEUE_H_ */
@@ -0,0 +1,300 @@
+/*
+ * statestream.c
+ *
+ * Machine readable state streaming on the terminal UART.
+ *
+ * Frame format:
+ *   0xF1, seq, type, len, payload[len], check
+ * seq increments by one per frame. check is XOR of seq, type, len and payload.
+ * Multi byte values are little endian.
+ *
+ * Frame types and payload:
+ *   SNAP_BEGIN   routes (16), feedbacks (16), switches (16)
+ *   SNAP_ROUTE   first route (16), route states packed 2 bits each, LSB first
+ *   SNAP_FB      first address (16), occupied bits, LSB first
+ *   SNAP_SW      first address (16), G bits, LSB first
+ *   SNAP_END     -
+ *   ROUTE        route (16), state
+ *   FB           address (16), 1 = occupied
+ *   SW           address (16), 1 = G
+ *
+ * Frames are escaped by term_tx_frame() (see term.h).
+ *
+ * Changes are queued from the moment a snapshot starts, and sent after it.
+ * If the change queue overflows, or the host sends TERM_RESYNC_REQ, a new
+ * snapshot is sent.
+ *
+ * Created: 19-10-2026 15:22:16
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "fb_handler.h"
+#include "route.h"
+#include "statestream.h"
+#include "sw_handler.h"
+#include "term.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#define FRAME_START     0xF1
+#define SNAP_BYTES      12      // Payload state bytes per snapshot frame
+#define CHANGES_SIZE    32      // Must be power of 2
+
+#ifndef FEEDBACK_ADR_MAX
+#define FEEDBACK_ADR_MAX 4096
+#endif
+#ifndef SW_ADR_MAX
+#define SW_ADR_MAX 2048
+#endif
+
+typedef enum
+{
+    SS_SNAP_BEGIN = 1,
+    SS_SNAP_ROUTE,
+    SS_SNAP_FB,
+    SS_SNAP_SW,
+    SS_SNAP_END,
+    SS_ROUTE,
+    SS_FB,
+    SS_SW
+} ss_type_t;
+
+typedef enum
+{
+    SS_STATE_OFF,
+    SS_STATE_BEGIN,
+    SS_STATE_ROUTE,
+    SS_STATE_FB,
+    SS_STATE_SW,
+    SS_STATE_END,
+    SS_STATE_CHANGES
+} ss_state_t;
+
+typedef struct
+{
+    uint8_t         type;
+    uint8_t         val;
+    uint16_t        adr;
+} ss_change_t;
+
+static ss_state_t state = SS_STATE_OFF;
+static uint16_t snap_pos;
+static uint8_t  seq = 0;
+
+static ss_change_t changes[CHANGES_SIZE];
+static uint8_t  changes_widx = 0;
+static uint8_t  changes_ridx = 0;
+static bool     changes_overflow = false;
+
+
+static bool send_frame(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    uint8_t         frame[4 + 2 + SNAP_BYTES + 1];
+    uint8_t         check, i;
+
+    frame[0] = FRAME_START;
+    frame[1] = seq;
+    frame[2] = type;
+    frame[3] = len;
+    check = seq ^ type ^ len;
+    for (i = 0; i < len; i++)
+    {
+        frame[4 + i] = payload[i];
+        check ^= payload[i];
+    }
+    frame[4 + len] = check;
+
+    if (!term_tx_frame(frame, 5 + len))
+        return false;
+    seq++;
+    return true;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static uint16_t snap_fill(uint8_t *p, uint16_t first, uint16_t last, bool (*get)(uint16_t))
+{
+    uint16_t        adr = first;
+    uint8_t         i, bit;
+
+    put16(p, first);
+    for (i = 0; i < SNAP_BYTES && adr <= last; i++)
+    {
+        p[2 + i] = 0;
+        for (bit = 0; bit < 8 && adr <= last; bit++, adr++)
+        {
+            if (get(adr))
+                p[2 + i] |= 1 << bit;
+        }
+    }
+    return adr;
+}
+
+static void snapshot_start(void)
+{
+    changes_ridx = changes_widx;
+    changes_overflow = false;
+    state = SS_STATE_BEGIN;
+}
+
+static void changes_put(uint8_t type, uint16_t adr, uint8_t val)
+{
+    uint8_t         next = (changes_widx + 1) & (CHANGES_SIZE - 1);
+
+    if (state == SS_STATE_OFF)
+        return;
+
+    if (next == changes_ridx)
+    {
+        changes_overflow = true;
+        return;
+    }
+    changes[changes_widx].type = type;
+    changes[changes_widx].adr = adr;
+    changes[changes_widx].val = val;
+    changes_widx = next;
+}
+
+
+void statestream_update(void)
+{
+    uint8_t         buf[2 + SNAP_BYTES];
+    uint16_t        next;
+    uint8_t         i, s;
+
+    switch (state)
+    {
+    case SS_STATE_OFF:
+    default:
+        break;
+
+    case SS_STATE_BEGIN:
+        put16(buf, MAXROUTES);
+        put16(buf + 2, FEEDBACK_ADR_MAX);
+        put16(buf + 4, SW_ADR_MAX);
+        if (send_frame(SS_SNAP_BEGIN, buf, 6))
+        {
+            snap_pos = 0;
+            state = SS_STATE_ROUTE;
+        }
+        break;
+
+    case SS_STATE_ROUTE:
+        put16(buf, snap_pos);
+        next = snap_pos;
+        for (i = 0; i < SNAP_BYTES && next < MAXROUTES; i++)
+        {
+            buf[2 + i] = 0;
+            for (s = 0; s < 8 && next < MAXROUTES; s += 2, next++)
+                buf[2 + i] |= (route_state(next) & 3) << s;
+        }
+        if (send_frame(SS_SNAP_ROUTE, buf, 2 + i))
+        {
+            snap_pos = next;
+            if (snap_pos >= MAXROUTES)
+            {
+                snap_pos = 1;
+                state = SS_STATE_FB;
+            }
+        }
+        break;
+
+    case SS_STATE_FB:
+        next = snap_fill(buf, snap_pos, FEEDBACK_ADR_MAX, fb_handler_get_state);
+        if (send_frame(SS_SNAP_FB, buf, 2 + (next - snap_pos + 7) / 8))
+        {
+            snap_pos = next;
+            if (snap_pos > FEEDBACK_ADR_MAX)
+            {
+                snap_pos = 1;
+                state = SS_STATE_SW;
+            }
+        }
+        break;
+
+    case SS_STATE_SW:
+        next = snap_fill(buf, snap_pos, SW_ADR_MAX, sw_handler_get_state);
+        if (send_frame(SS_SNAP_SW, buf, 2 + (next - snap_pos + 7) / 8))
+        {
+            snap_pos = next;
+            if (snap_pos > SW_ADR_MAX)
+                state = SS_STATE_END;
+        }
+        break;
+
+    case SS_STATE_END:
+        if (send_frame(SS_SNAP_END, buf, 0))
+            state = SS_STATE_CHANGES;
+        break;
+
+    case SS_STATE_CHANGES:
+        if (changes_overflow)
+        {
+            snapshot_start();
+            break;
+        }
+        while (changes_ridx != changes_widx)
+        {
+            ss_change_t    *c = &changes[changes_ridx];
+
+            put16(buf, c->adr);
+            buf[2] = c->val;
+            if (!send_frame(c->type, buf, 3))
+                break;
+            changes_ridx = (changes_ridx + 1) & (CHANGES_SIZE - 1);
+        }
+        break;
+    }
+}
+
+
+void statestream_resync(void)
+{
+    if (state != SS_STATE_OFF)
+        snapshot_start();
+}
+
+
+void statestream_route(uint16_t num, uint8_t st)
+{
+    changes_put(SS_ROUTE, num, st);
+}
+
+
+void statestream_fb(uint16_t adr, bool occ)
+{
+    changes_put(SS_FB, adr, occ);
+}
+
+
+void statestream_sw(uint16_t adr, bool dir)
+{
+    changes_put(SS_SW, adr, dir);
+}
+
+
+static void streamCmd(uint8_t argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf_P(PSTR("Usage: stream <0|1>\n"));
+        printf_P(PSTR(" 1 : Start streaming with a full snapshot\n"));
+        printf_P(PSTR(" 0 : Stop streaming\n"));
+        return;
+    }
+
+    if (strtoul(argv[1], NULL, 0))
+        snapshot_start();
+    else
+        state = SS_STATE_OFF;
+}
+
+CMD(stream, "State streaming");
@@ -0,0 +1,56 @@
+/*
+ * statestream.h
+ *
+ * Machine readable state streaming on the terminal UART.
+ * When enabled, a full snapshot of route, feedback and switch states is
+ * sent, followed by changes only. See statestream.c for the frame format.
+ *
+ * Created: 19-10-2026 15:22:03
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#ifndef STATESTREAM_H_
+#define STATESTREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Update state stream module.
+ *
+ * Call regularly from mainloop.
+ */
+extern void     statestream_update(void);
+
+/**
+ * Send a new snapshot, if streaming.
+ *
+ * Requested by the host when it has lost sync (TERM_RESYNC_REQ).
+ */
+extern void     statestream_resync(void);
+
+/**
+ * Report changed route state.
+ *
+ * @param num   Route number.
+ * @param state New route state.
+ */
+extern void     statestream_route(uint16_t num, uint8_t state);
+
+/**
+ * Report changed feedback state.
+ *
+ * @param adr Feedback address.
+ * @param occ True if occupied.
+ */
+extern void     statestream_fb(uint16_t adr, bool occ);
+
+/**
+ * Report changed switch state.
+ *
+ * @param adr Switch address.
+ * @param dir True if G, false if R.
+ */
+extern void     statestream_sw(uint16_t adr, bool dir);
+
+#endif /* STATESTREAM_H_ */
@@ -14,8 +14,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "capture.h"
 #include "flashmem.h"
+#include "local_out.h"
+#include "perf.h"
+#include "statestream.h"
 #include "sw_handler.h"
+#include "term.h"
 #include "lib/avr-shell-cmd/cmd.h"
 #include "lib/loconet-avrda/hal_ln.h"
 #include "lib/loconet-avrda/ln_rx.h"
@@ -31,6 +36,7 @@
 #define SW_ARRAY_SIZE ((SW_ADR_MAX + 7) / 8)
 
 static uint8_t  sw_state[SW_ARRAY_SIZE];
+static uint16_t sw_cnt = 0;
 
 extern const FLASHMEM switchreq_table_t __loconet_swreqtable_start;
 extern const FLASHMEM switchreq_table_t __loconet_swreqtable_end;
@@ -49,6 +55,7 @@ void sw_handler_update(void)
         {
             printf_P(PSTR("Reading SW states\n"));
             init_done = true;
+            local_out_sync_state();     // Local outputs were set R at startup
         }
     }
 #endif
@@ -63,9 +70,8 @@ void sw_handler_set_state(uint16_t adr, bool dir)
     if (adr == 0 || adr > SW_ADR_MAX)
         return;
 
-    adr--;
-    idx = adr / 8;
-    mask = __builtin_avr_mask1(1, adr & 7);
+    idx = (adr - 1) / 8;
+    mask = __builtin_avr_mask1(1, (adr - 1) & 7);
     val = sw_state[idx];
     if (dir)                    // G
         val |= mask;
@@ -74,6 +80,7 @@ void sw_handler_set_state(uint16_t adr, bool dir)
     if (val != sw_state[idx])
     {
         sw_state[idx] = val;
+        statestream_sw(adr, dir);
 #ifdef EERAM
         eeram_write(idx, val);
 #endif
@@ -96,18 +103,38 @@ bool sw_handler_get_state(uint16_t adr)
 }
 
 
+static uint16_t list_adr, list_end;
+
+static bool sws_list_cont(void)
+{
+    printf_P(PSTR("Switch %u: %c\n"), list_adr, sw_handler_get_state(list_adr) ? 'G' : 'R');
+    return list_adr++ < list_end;
+}
+
 static void swsCmd(uint8_t argc, char *argv[])
 {
     uint16_t        adr;
 
     if (argc < 2)
     {
-        printf_P(PSTR("Usage: sws <adr>\n"));
+        printf_P(PSTR("Usage: sws <adr> [<adrto>]\n"));
         printf_P(PSTR(" <adr>   : Switch address\n"));
+        printf_P(PSTR(" <adrto> : List switch addresses from adr to adrto\n"));
         return;
     }
 
     adr = strtoul(argv[1], NULL, 0);
+    if (argc >= 3)
+    {
+        list_adr = adr;
+        list_end = strtoul(argv[2], NULL, 0);
+        if (list_end > SW_ADR_MAX)
+            list_end = SW_ADR_MAX;
+        if (list_adr <= list_end)
+            term_continue(sws_list_cont);
+        return;
+    }
+
     if (sw_handler_get_state(adr))
         printf_P(PSTR("G\n"));
     else
@@ -197,10 +224,22 @@ static void swreq_range_callback(uint16_t adr, bool dir)
 
 void ln_rx_opc_sw_req(uint16_t adr, uint8_t dir, uint8_t on)
 {
+    sw_cnt++;
+    capture_put(CAPTURE_RX_SW, adr, (dir ? 1 : 0) | (on ? 2 : 0));
+
     if (on != 0)
     {
+        hrticks_t       t0 = ticks_hr_get();
+
+        local_out_set(adr, dir != 0);
         sw_handler_set_state(adr, dir != 0);
         swreq_callback(adr, dir != 0);
         swreq_range_callback(adr, dir != 0);
+        perf_record(PERF_DISPATCH_SW, ticks_hr_elapsed(t0));
     }
 }
+
+uint16_t sw_handler_get_packets_received(void)
+{
+    return sw_cnt;
+}
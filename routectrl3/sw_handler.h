@@ -93,4 +93,12 @@ extern void     sw_handler_set_state(uint16_t adr, bool dir);
  */
 extern bool     sw_handler_get_state(uint16_t adr);
 
+/**
+ * Get number of received switch request packets.
+ * Wraps at overflow.
+ *
+ * @return    Switch request packets received.
+ */
+extern uint16_t sw_handler_get_packets_received(void);
+
 #endif /* SW_HANDLER_H_ */
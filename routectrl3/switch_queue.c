@@ -5,15 +5,20 @@
  *  Author: Mikael Ejberg Pedersen
  */
 
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include "bus_load.h"
+#include "capture.h"
+#include "latency.h"
 #include "sw_handler.h"
 #include "switch_queue.h"
 #include "ticks.h"
+#include "trace.h"
 #include "lib/loconet-avrda/ln_tx.h"
 
 #define SWITCH_ACTIVE_TIME  TICKS_FROM_MS(327)
-#define SWITCH_DELAY_TIME   TICKS_FROM_MS(50)
 #define QUEUE_SIZE          16
 
 typedef enum
@@ -29,6 +34,7 @@ typedef struct
 {
     uint16_t        adr:15;
     uint16_t        dir:1;
+    latency_cause_t cause;
 } swq_switch_t;
 
 static swq_switch_t queue[QUEUE_SIZE];
@@ -37,25 +43,70 @@ static uint8_t  queue_widx = 0;
 
 static ticks_t  last_activity = 0;
 static swq_state_t state = SWQ_STATE_IDLE;
+static uint8_t  queue_peak = 0;
+static uint16_t queue_dropped = 0;
+static bool     queue_full = false;     // Reported, until a request fits again
 
 
 void switch_queue_add(uint16_t adr, bool dir)
 {
-    // NOTE: There is no buffer full check
+    uint8_t         used = (queue_widx + QUEUE_SIZE - queue_ridx) % QUEUE_SIZE;
+
+    if (used >= QUEUE_SIZE - 1)
+    {
+        if (queue_dropped < UINT16_MAX)
+            queue_dropped++;
+        TRACE(TRACE_MOD_ROUTE_QUEUE, TRACE_ERROR, TRACE_EV_SWQ_DROP, adr, dir);
+        if (!queue_full)
+            printf_P(PSTR("ERROR: Switch queue full, dropping requests\n"));
+        queue_full = true;
+        return;
+    }
+    queue_full = false;
+    if (used + 1 > queue_peak)
+        queue_peak = used + 1;
+
     queue[queue_widx].adr = adr;
     queue[queue_widx].dir = dir;
+    queue[queue_widx].cause = latency_cause_get();
     queue_widx++;
     if (queue_widx >= QUEUE_SIZE)
         queue_widx = 0;
 }
 
+void switch_queue_drop(uint16_t adr)
+{
+    uint8_t         i, j;
+
+    // The request at the read index is being sent, unless idle
+    i = queue_ridx;
+    if (state != SWQ_STATE_IDLE)
+        i = (i + 1) % QUEUE_SIZE;
+
+    for (j = i; i != queue_widx; i = (i + 1) % QUEUE_SIZE)
+    {
+        if (queue[i].adr != adr)
+        {
+            queue[j] = queue[i];
+            j = (j + 1) % QUEUE_SIZE;
+        }
+    }
+    queue_widx = j;
+}
+
 static void sw_cb(void *ctx, hal_ln_result_t res)
 {
     if (res == HAL_LN_SUCCESS)
     {
         // OPC_SW_REQ sent. Activate next state.
-        last_activity = ticks_get();
+        // Same clock as switch_queue_update() compares with (the RTC may have ticked since the snapshot)
+        last_activity = ticks_now();
         state = *(swq_state_t *)ctx;
+        if (state == SWQ_STATE_ACTIVE)
+            latency_record(queue[queue_ridx].adr, queue[queue_ridx].cause);
+#ifndef LNECHO
+        bus_load_tx();
+#endif
     }
     else
     {
@@ -76,6 +127,7 @@ void switch_queue_update(void)
         {
             if (ln_tx_opc_sw_req(queue[queue_ridx].adr, queue[queue_ridx].dir, true, sw_cb, &next_state) == 0)
             {
+                capture_put(CAPTURE_TX_SW, queue[queue_ridx].adr, queue[queue_ridx].dir | 2);
                 state = SWQ_STATE_WAIT_CB;
                 next_state = SWQ_STATE_ACTIVE;
             }
@@ -91,10 +143,11 @@ void switch_queue_update(void)
         break;
 
     case SWQ_STATE_ACTIVE_DELAY:
-        if (ticks_elapsed(last_activity) >= SWITCH_ACTIVE_TIME)
+        if (ticks_now_elapsed(last_activity) >= SWITCH_ACTIVE_TIME)
         {
             if (ln_tx_opc_sw_req(queue[queue_ridx].adr, queue[queue_ridx].dir, false, sw_cb, &next_state) == 0)
             {
+                capture_put(CAPTURE_TX_SW, queue[queue_ridx].adr, queue[queue_ridx].dir);
                 state = SWQ_STATE_WAIT_CB;
                 next_state = SWQ_STATE_DELAY;
             }
@@ -102,7 +155,7 @@ void switch_queue_update(void)
         break;
 
     case SWQ_STATE_DELAY:
-        if (ticks_elapsed(last_activity) >= SWITCH_DELAY_TIME)
+        if (ticks_now_elapsed(last_activity) >= bus_load_gap())
         {
             queue_ridx++;
             if (queue_ridx >= QUEUE_SIZE)
@@ -117,6 +170,16 @@ void switch_queue_update(void)
     }
 }
 
+uint16_t switch_queue_stat(uint8_t *peak)
+{
+    uint16_t        dropped = queue_dropped;
+
+    *peak = queue_peak;
+    queue_peak = 0;
+    queue_dropped = 0;
+    return dropped;
+}
+
 bool switch_queue_empty(void)
 {
     return (state == SWQ_STATE_IDLE && queue_ridx == queue_widx);
@@ -29,6 +29,15 @@ extern void     switch_queue_update(void);
  */
 extern void     switch_queue_add(uint16_t adr, bool dir);
 
+/**
+ * Drop queued switch requests for an address.
+ *
+ * A request that is being sent is not dropped.
+ *
+ * @param adr Address of switch.
+ */
+extern void     switch_queue_drop(uint16_t adr);
+
 /**
  * Get switch queue empty status.
  *
@@ -36,4 +45,12 @@ extern void     switch_queue_add(uint16_t adr, bool dir);
  */
 extern bool     switch_queue_empty(void);
 
+/**
+ * Get switch queue statistics since last call.
+ *
+ * @param peak Returns max number of queued switch requests.
+ * @return Number of switch requests dropped because the queue was full.
+ */
+extern uint16_t switch_queue_stat(uint8_t *peak);
+
 #endif /* SWITCH_QUEUE_H_ */
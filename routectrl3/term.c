@@ -5,51 +5,79 @@
  *  Author: Mikael Ejberg Pedersen
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <util/atomic.h>
+#include "statestream.h"
 #include "term.h"
+#include "trace.h"
 #include "lib/avr-shell-cmd/cmd.h"
 
 #define BAUDRATE 115200UL
 #define BAUD_REG ((64 * F_CPU + 8 * BAUDRATE) / (16 * BAUDRATE))
 
+// XON/XOFF flow control on input. Define TERM_NO_FLOWCTRL to disable
+#define XON  0x11
+#define XOFF 0x13
+
 
 /**************/
 /* TX section */
 
-#define TXBUF_LEN  512
+/*
+ * Output is non-blocking, except while a shell command is executing.
+ * Characters that do not fit in txbuf are dropped, and a marker with the
+ * number of dropped bytes is inserted when there is room again.
+ */
+
+#define TXBUF_LEN  512          // Must be power of 2
 static char     txbuf[TXBUF_LEN];
 static uint16_t txbuf_widx = 0;
 static volatile uint16_t txbuf_ridx = 0;
 
+#define DROP_MARKER_LEN 26      // "\r\n[65535 bytes dropped]\r\n"
+static bool     tx_blocking = false;
+static uint16_t tx_dropped = 0;
+static uint32_t tx_dropped_total = 0;
+
+static volatile char tx_flow = 0;      // XON/XOFF to send ahead of txbuf
+
 ISR(USART1_DRE_vect)
 {
-    USART1.TXDATAL = txbuf[txbuf_ridx++];
-    if (txbuf_ridx >= TXBUF_LEN)
-        txbuf_ridx = 0;
-    if (txbuf_ridx == txbuf_widx)
+    if (tx_flow)
+    {
+        USART1.TXDATAL = tx_flow;
+        tx_flow = 0;
+    }
+    else
+    {
+        USART1.TXDATAL = txbuf[txbuf_ridx++];
+        if (txbuf_ridx >= TXBUF_LEN)
+            txbuf_ridx = 0;
+    }
+    if (txbuf_ridx == txbuf_widx && !tx_flow)
         USART1.CTRLA &= ~USART_DREIE_bm;
 }
 
-static int tx_char(char c, FILE *stream)
+static uint16_t tx_free(void)
 {
     uint16_t        rtmp;
 
-    if (c == '\n')
-        tx_char('\r', stream);
-
-    do
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-        {
-            rtmp = txbuf_ridx;
-        }
-    } while ((rtmp == txbuf_widx) && (USART1.CTRLA & USART_DREIE_bm));
+        rtmp = txbuf_ridx;
+    }
+
+    // One byte is kept unused to tell full from empty
+    return (rtmp - txbuf_widx - 1) & (TXBUF_LEN - 1);
+}
 
+static void tx_put(char c)
+{
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
         txbuf[txbuf_widx++] = c;
@@ -58,10 +86,95 @@ static int tx_char(char c, FILE *stream)
         if (!(USART1.CTRLA & USART_DREIE_bm))
             USART1.CTRLA |= USART_DREIE_bm;
     }
+}
+
+static void tx_put_esc(uint8_t c)
+{
+    if (c == XON || c == XOFF || (c >= TRACE_FRAME_START && c <= TERM_FRAME_ESC))
+    {
+        tx_put(TERM_FRAME_ESC);
+        c ^= TERM_FRAME_ESC_XOR;
+    }
+    tx_put(c);
+}
+
+static void tx_put_str_P(const char *s)
+{
+    char            c;
+
+    while ((c = pgm_read_byte(s++)))
+        tx_put(c);
+}
+
+static void tx_drop_marker(void)
+{
+    char            num[6];
+    uint8_t         i = 0;
+
+    do
+    {
+        num[i++] = '0' + tx_dropped % 10;
+        tx_dropped /= 10;
+    } while (tx_dropped);
+
+    tx_put_str_P(PSTR("\r\n["));
+    while (i)
+        tx_put(num[--i]);
+    tx_put_str_P(PSTR(" bytes dropped]\r\n"));
+}
+
+static int tx_char(char c, FILE *stream)
+{
+    if (c == '\n')
+        tx_char('\r', stream);
+
+    if (tx_blocking)
+    {
+        while (tx_free() < (tx_dropped ? DROP_MARKER_LEN + 1 : 1))
+        {
+        }
+    }
+    else if (tx_free() < (tx_dropped ? DROP_MARKER_LEN + 1 : 1))
+    {
+        if (tx_dropped < UINT16_MAX)
+            tx_dropped++;
+        tx_dropped_total++;
+        return 0;
+    }
+
+    if (tx_dropped)
+        tx_drop_marker();
+    tx_put(c);
 
     return 0;
 }
 
+static void tx_trace(void)
+{
+    uint8_t         rec[TRACE_REC_LEN];
+    uint8_t         i;
+
+    // Only use the upper half of txbuf, leaving room for text output. Escaping may double the record
+    while (tx_free() >= TXBUF_LEN / 2 + 2 * TRACE_REC_LEN && trace_get(rec))
+    {
+        tx_put(TRACE_FRAME_START);
+        for (i = 0; i < TRACE_REC_LEN; i++)
+            tx_put_esc(rec[i]);
+    }
+}
+
+bool term_tx_frame(const uint8_t *buf, uint8_t len)
+{
+    // Same reserve as trace frames, and never split a frame
+    if (tx_free() < TXBUF_LEN / 2 + 2 * len)
+        return false;
+
+    tx_put(*buf++);
+    while (--len)
+        tx_put_esc(*buf++);
+    return true;
+}
+
 static void prompt(void)
 {
     printf_P(PSTR("AVR128DA>"));
@@ -71,37 +184,131 @@ static void prompt(void)
 /**************/
 /* RX section */
 
-#define RXBUF_LEN 32
+/*
+ * XOFF is sent when rxbuf is 3/4 full, and XON when it has been drained
+ * to 1/4. Characters arriving while rxbuf is full are counted as overflow.
+ */
+
+#define RXBUF_LEN 128
+#define RX_XOFF_LEVEL (RXBUF_LEN * 3 / 4)
+#define RX_XON_LEVEL  (RXBUF_LEN / 4)
 static char     rxbuf[RXBUF_LEN];
 static volatile uint16_t rxbuf_widx = 0;
 static uint16_t rxbuf_ridx = 0;
+static volatile uint16_t rx_overflow = 0;
+static volatile bool rx_xoff = false;
 
 ISR(USART1_RXC_vect)
 {
-    rxbuf[rxbuf_widx++] = USART1.RXDATAL;
-    if (rxbuf_widx >= RXBUF_LEN)
-        rxbuf_widx = 0;
+    uint16_t        widx = rxbuf_widx;
+
+    if (USART1.RXDATAH & USART_BUFOVF_bm)
+        rx_overflow++;          // Hardware buffer overflow
+
+    rxbuf[widx] = USART1.RXDATAL;
+    if (++widx >= RXBUF_LEN)
+        widx = 0;
+    if (widx == rxbuf_ridx)
+    {
+        rx_overflow++;          // rxbuf full. Drop character
+        return;
+    }
+    rxbuf_widx = widx;
+
+#ifndef TERM_NO_FLOWCTRL
+    if (!rx_xoff && (widx + RXBUF_LEN - rxbuf_ridx) % RXBUF_LEN >= RX_XOFF_LEVEL)
+    {
+        rx_xoff = true;
+        tx_flow = XOFF;
+        USART1.CTRLA |= USART_DREIE_bm;
+    }
+#endif
+}
+
+static void rx_flow_update(void)
+{
+#ifndef TERM_NO_FLOWCTRL
+    uint16_t        fill;
+
+    if (!rx_xoff)
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        fill = (rxbuf_widx + RXBUF_LEN - rxbuf_ridx) % RXBUF_LEN;
+        if (fill <= RX_XON_LEVEL)
+        {
+            rx_xoff = false;
+            tx_flow = XON;
+            USART1.CTRLA |= USART_DREIE_bm;
+        }
+    }
+#endif
 }
 
 #define LINE_LEN 128
 
-void term_update(void)
+
+/*******************/
+/* Resumable shell */
+
+/*
+ * A shell command with lots of output calls term_continue() and returns.
+ * The continuation is then called once per term_update, while there is
+ * room for CONT_CHUNK_SPACE bytes of output, until it returns false.
+ * Input is discarded until it is done. Ctrl-C aborts.
+ */
+
+#define CONT_CHUNK_SPACE 64
+
+static term_cont_cb *cont = NULL;
+
+void term_continue(term_cont_cb *cb)
+{
+    cont = cb;
+}
+
+static void cont_update(void)
 {
-    static char     line[LINE_LEN];
-    static uint16_t chars = 0;
     uint16_t        i;
-    char            c;
+    bool            ctrl_c = false;
 
+    // Input while a command continues is discarded, so rxbuf can't fill up
+    // and hold back a Ctrl-C behind XOFF. Ctrl-C anywhere in it aborts the command
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
         i = rxbuf_widx;
     }
-    if (i == rxbuf_ridx)
+    while (rxbuf_ridx != i)
+    {
+        if (rxbuf[rxbuf_ridx] == 0x03)
+            ctrl_c = true;
+        if (++rxbuf_ridx >= RXBUF_LEN)
+            rxbuf_ridx = 0;
+    }
+    if (ctrl_c)
+    {
+        printf_P(PSTR("^C\n"));
+        cont = NULL;
+        prompt();
         return;
+    }
+
+    if (tx_free() < CONT_CHUNK_SPACE)
+        return;
+
+    if (!cont())
+    {
+        cont = NULL;
+        prompt();
+    }
+}
+
 
-    c = rxbuf[rxbuf_ridx++];
-    if (rxbuf_ridx >= RXBUF_LEN)
-        rxbuf_ridx = 0;
+static void rx_char(char c)
+{
+    static char     line[LINE_LEN];
+    static uint16_t chars = 0;
 
     switch (c)
     {
@@ -109,8 +316,16 @@ void term_update(void)
         putchar('\n');
         line[chars] = 0;
         chars = 0;
+        // Shell command output is wanted in full. Block while executing
+        tx_blocking = true;
         cmd_split_exec(line);
-        prompt();
+        if (!cont)
+            prompt();
+        tx_blocking = false;
+        break;
+
+    case TERM_RESYNC_REQ:
+        statestream_resync();
         break;
 
     case 0x7f:                 // Backspace
@@ -131,6 +346,41 @@ void term_update(void)
     }
 }
 
+void term_update(void)
+{
+    uint16_t        i;
+    char            c;
+
+    if (trace_streaming())
+        tx_trace();
+
+    if (cont)
+    {
+        cont_update();
+        rx_flow_update();
+        return;
+    }
+
+    // Handle all received characters, unless a command needs to continue
+    for (;;)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            i = rxbuf_widx;
+        }
+        if (i == rxbuf_ridx || cont)
+            break;
+
+        c = rxbuf[rxbuf_ridx++];
+        if (rxbuf_ridx >= RXBUF_LEN)
+            rxbuf_ridx = 0;
+
+        rx_char(c);
+    }
+
+    rx_flow_update();
+}
+
 
 /**********/
 /* Common */
@@ -153,3 +403,17 @@ void term_init(void)
     stdout = &dbg_uart;
     prompt();
 }
+
+uint32_t term_tx_dropped(void)
+{
+    return tx_dropped_total;
+}
+
+
+static void termCmd(uint8_t argc, char *argv[])
+{
+    printf_P(PSTR("TX dropped:  %lu bytes\n"), tx_dropped_total);
+    printf_P(PSTR("RX overflow: %u\n"), rx_overflow);
+}
+
+CMD(term, "Terminal statistics");
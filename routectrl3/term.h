@@ -9,7 +9,63 @@
 #ifndef TERM_H_
 #define TERM_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Binary frames start with a byte from 0xF0 (trace, statestream). Inside a
+ * frame, XON, XOFF and 0xF0-0xF2 are sent as TERM_FRAME_ESC followed by the
+ * byte XOR TERM_FRAME_ESC_XOR. XON/XOFF may appear anywhere in the output,
+ * also inside frames, and must be dropped by decoders.
+ */
+#define TERM_FRAME_ESC      0xF2
+#define TERM_FRAME_ESC_XOR  0x20
+
+/*
+ * Received byte that requests a new state stream snapshot (DC2).
+ * Decoders send it when they lose sync.
+ */
+#define TERM_RESYNC_REQ     0x12
+
+/*
+ * Continuation callback for resumable shell commands.
+ *
+ * @return True if there is more output to come.
+ */
+typedef bool    (term_cont_cb) (void);
+
 extern void     term_init(void);
 extern void     term_update(void);
 
+/*
+ * Continue shell command incrementally.
+ *
+ * Call from a shell command before returning. The callback is called once
+ * per mainloop iteration when there is room for a line or two of output,
+ * until it returns false. Then the prompt is shown.
+ *
+ * @param cb Continuation callback.
+ */
+extern void     term_continue(term_cont_cb *cb);
+
+/*
+ * Get number of output bytes dropped because the TX buffer was full.
+ *
+ * @return Dropped bytes since startup.
+ */
+extern uint32_t term_tx_dropped(void);
+
+/*
+ * Send binary frame.
+ *
+ * The frame is sent in one piece, or not at all. The first byte is the
+ * frame start, the rest is escaped. Half of the TX buffer is kept free
+ * for text output.
+ *
+ * @param buf Frame data, starting with the frame start byte.
+ * @param len Frame length.
+ * @return True if frame was queued, false if no room. Retry later.
+ */
+extern bool     term_tx_frame(const uint8_t *buf, uint8_t len);
+
 #endif /* TERM_H_ */
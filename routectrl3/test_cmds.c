@@ -7,13 +7,18 @@
 
 #include <avr/pgmspace.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "route.h"
 #include "switch_queue.h"
+#include "term.h"
 #include "ticks.h"
 #include "timer.h"
 #include "lib/avr-shell-cmd/cmd.h"
+#include "lib/loconet-avrda/ln_rx.h"
 #include "lib/loconet-avrda/ln_tx.h"
 
 
@@ -52,7 +57,7 @@ static void in_cb(void *ctx, hal_ln_result_t res)
     if (res == HAL_LN_SUCCESS)
     {
         // OPC_INPUT_REP track occupied sent. Wait before sending track free.
-        if (timer_add(p->delay, in_timer_cb, p) == 0)
+        if (timer_add(p->delay, in_timer_cb, p) != TIMER_HANDLE_INVALID)
             return;
     }
 
@@ -149,16 +154,209 @@ CMD(sw, "Send OPC_SW_REQ");
 /*
  * Test command TIME
  *
- * Time a command
+ * Time a command.
+ * Microseconds are only valid for commands shorter than the hrticks wrap time.
  */
 static void timeCmd(uint8_t argc, char *argv[])
 {
     ticks_t         t0 = ticks_get();
+    hrticks_t       hr0 = ticks_hr_get();
 
     if (argc >= 2)
         cmd_exec(argc - 1, argv + 1);
+    hr0 = ticks_hr_elapsed(hr0);
     t0 = ticks_elapsed(t0);
-    printf_P(PSTR("Time: %u ticks\n"), t0);
+    if (t0 < TICKS_FROM_SEC(170))
+        printf_P(PSTR("Time: %lu us (%lu cycles)\n"), HRTICKS_TO_US(hr0), hr0);
+    else
+        printf_P(PSTR("Time: %lu ticks\n"), t0);
 }
 
 CMD(time, "Time a command");
+
+
+/********************************************************************/
+
+
+/*
+ * Test command LOOP
+ *
+ * Mainloop statistics since last call.
+ * Build with TICKS_NOW_PRECISE to compare against reading the RTC in every update function.
+ */
+static void loopCmd(uint8_t argc, char *argv[])
+{
+    static ticks_t  t_last = 0;
+    ticks_t         elapsed;
+    hrticks_t       max;
+    uint32_t        cnt;
+
+    cnt = ticks_loop_stat(&max);
+    elapsed = ticks_elapsed(t_last);
+    t_last = ticks_get();
+
+    printf_P(PSTR("Loops:    %lu in %lu ticks\n"), cnt, elapsed);
+    if (cnt)
+        printf_P(PSTR("Avg loop: %lu us\n"), (uint32_t)(((uint64_t)elapsed * 1000000UL) / TICKS_PER_SEC / cnt));
+    printf_P(PSTR("Max loop: %lu us (%lu cycles)\n"), HRTICKS_TO_US(max), max);
+}
+
+CMD(loop, "Mainloop statistics");
+
+
+/********************************************************************/
+
+
+/*
+ * Test command LOAD
+ *
+ * Generates synthetic feedback and/or switch events at a given rate for a
+ * given time, either internally (into the Loconet RX handlers) or on the bus.
+ * On the bus switch requests are sent OFF only. They load the bus the same,
+ * but leave no switch decoder output on.
+ * Runs from the shell continuation callback, so the mainloop keeps running.
+ * Then prints throughput, drops, queue peaks and mainloop statistics.
+ */
+
+#define LOAD_BURST_MAX 16       // Max events per mainloop iteration
+
+typedef struct
+{
+    uint16_t        rate;       // Events per second
+    ticks_t         duration;
+    ticks_t         t0;
+    uint16_t        adr_from;
+    uint16_t        adr_to;
+    uint16_t        adr;
+    bool            fb;
+    bool            sw;
+    bool            bus;
+    bool            val;
+    uint32_t        sent;
+    uint32_t        tx_fail;
+    uint16_t        rq_dropped;
+    uint16_t        swq_dropped;
+    uint8_t         rq_peak;
+    uint8_t         swq_peak;
+    uint32_t        loops;
+    hrticks_t       loop_max;
+} load_t;
+
+static load_t   load;
+
+static void load_stat(void)
+{
+    uint8_t         peak;
+    hrticks_t       max;
+
+    load.rq_dropped += route_send_stat(&peak);
+    if (peak > load.rq_peak)
+        load.rq_peak = peak;
+    load.swq_dropped += switch_queue_stat(&peak);
+    if (peak > load.swq_peak)
+        load.swq_peak = peak;
+    load.loops += ticks_loop_stat(&max);
+    if (max > load.loop_max)
+        load.loop_max = max;
+}
+
+static void load_event(bool fb)
+{
+    if (load.bus)
+    {
+        // Switch requests are sent OFF, so no switch decoder is left with its output on
+        if ((fb ? ln_tx_opc_input_rep(load.adr, load.val, NULL, NULL)
+             : ln_tx_opc_sw_req(load.adr, load.val, false, NULL, NULL)) != 0)
+        {
+            load.tx_fail++;
+            return;
+        }
+    }
+    else
+    {
+        if (fb)
+            ln_rx_opc_input_rep(load.adr, load.val, 1);
+        else
+            ln_rx_opc_sw_req(load.adr, load.val, 1);
+    }
+    load.sent++;
+}
+
+static bool load_cont(void)
+{
+    ticks_t         elapsed = ticks_elapsed(load.t0);
+    uint32_t        due;
+    uint8_t         burst = 0;
+
+    if (elapsed > load.duration)
+        elapsed = load.duration;
+    due = (uint32_t)((uint64_t)elapsed * load.rate / TICKS_PER_SEC);
+
+    while (load.sent + load.tx_fail < due && burst++ < LOAD_BURST_MAX)
+    {
+        if (load.fb)
+            load_event(true);
+        if (load.sw && load.sent + load.tx_fail < due)
+            load_event(false);
+
+        // Next address. Toggle occupied/free or G/R each round
+        if (++load.adr > load.adr_to)
+        {
+            load.adr = load.adr_from;
+            load.val = !load.val;
+        }
+    }
+
+    load_stat();
+    if (elapsed < load.duration)
+        return true;
+
+    printf_P(PSTR("Events:      %lu in %lu ticks (%lu/s of %u/s)\n"), load.sent, elapsed,
+             (uint32_t)((uint64_t)load.sent * TICKS_PER_SEC / (elapsed ? elapsed : 1)), load.rate);
+    printf_P(PSTR("TX failed:   %lu\n"), load.tx_fail);
+    printf_P(PSTR("Route queue: peak %u, dropped %u\n"), load.rq_peak, load.rq_dropped);
+    printf_P(PSTR("Sw queue:    peak %u, dropped %u\n"), load.swq_peak, load.swq_dropped);
+    if (load.loops)
+        printf_P(PSTR("Loops:       %lu, avg %lu us, max %lu us\n"), load.loops,
+                 (uint32_t)((uint64_t)elapsed * 1000000UL / TICKS_PER_SEC / load.loops), HRTICKS_TO_US(load.loop_max));
+    return false;
+}
+
+static void loadCmd(uint8_t argc, char *argv[])
+{
+    if (argc < 6)
+    {
+        printf_P(PSTR("Usage: load <rate> <sec> <fb|sw|both> <adrfrom> <adrto> [bus]\n"));
+        printf_P(PSTR(" <rate>  : Events per second\n"));
+        printf_P(PSTR(" <sec>   : Duration in seconds\n"));
+        printf_P(PSTR(" bus     : Send on Loconet. Default is internal loopback\n"));
+        printf_P(PSTR("           Switch requests are sent OFF on Loconet\n"));
+        printf_P(PSTR("Ctrl-C stops. Events go to feedback/switch subscribers like real ones!\n"));
+        return;
+    }
+
+    memset(&load, 0, sizeof(load));
+    load.rate = strtoul(argv[1], NULL, 0);
+    load.duration = strtoul(argv[2], NULL, 0) * TICKS_PER_SEC;
+    load.fb = argv[3][0] == 'f' || argv[3][0] == 'b';
+    load.sw = argv[3][0] == 's' || argv[3][0] == 'b';
+    load.adr_from = strtoul(argv[4], NULL, 0);
+    load.adr_to = strtoul(argv[5], NULL, 0);
+    load.bus = argc >= 7 && argv[6][0] == 'b';
+    load.adr = load.adr_from;
+    load.val = true;
+    if (load.rate == 0 || load.adr_from > load.adr_to)
+    {
+        printf_P(PSTR("Bad argument\n"));
+        return;
+    }
+
+    // Reset statistics
+    load_stat();
+    memset(&load.rq_dropped, 0, sizeof(load) - offsetof(load_t, rq_dropped));
+
+    load.t0 = ticks_get();
+    term_continue(load_cont);
+}
+
+CMD(load, "Synthetic load generator");
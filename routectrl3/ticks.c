@@ -11,7 +11,18 @@
 #include <util/atomic.h>
 #include "ticks.h"
 
+// TCB used for high resolution ticks
+#ifndef TICKS_HR_TCB
+#define TICKS_HR_TCB        TCB2
+#define TICKS_HR_TCB_vect   TCB2_INT_vect
+#endif
+
 static volatile uint16_t cnt_h = 0;
+static volatile uint16_t hr_h = 0;
+static ticks_t  now_snapshot = 0;
+static hrticks_t hr_snapshot = 0;
+static uint32_t loop_cnt = 0;
+static hrticks_t loop_max = 0;
 
 void ticks_init(void)
 {
@@ -30,6 +41,14 @@ void ticks_init(void)
     {
     }
     RTC.CTRLA = RTC_PRESCALER_DIV32_gc | RTC_RTCEN_bm;
+
+    // Setup TCB to count CPU cycles. Interrupt at wrap extends count to 32 bits
+    TICKS_HR_TCB.CCMP = 0xFFFF;
+    TICKS_HR_TCB.CNT = 0;
+    TICKS_HR_TCB.CTRLB = TCB_CNTMODE_INT_gc;
+    TICKS_HR_TCB.INTFLAGS = TCB_CAPT_bm;
+    TICKS_HR_TCB.INTCTRL = TCB_CAPT_bm;
+    TICKS_HR_TCB.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_ENABLE_bm;
 }
 
 ISR(RTC_CNT_vect)
@@ -38,6 +57,12 @@ ISR(RTC_CNT_vect)
     RTC.INTFLAGS = RTC_OVF_bm;
 }
 
+ISR(TICKS_HR_TCB_vect)
+{
+    hr_h++;
+    TICKS_HR_TCB.INTFLAGS = TCB_CAPT_bm;
+}
+
 ticks_t ticks_get(void)
 {
     union
@@ -71,3 +96,63 @@ ticks_t ticks_elapsed(ticks_t t0)
 {
     return ticks_get() - t0;
 }
+
+hrticks_t ticks_hr_get(void)
+{
+    union
+    {
+        hrticks_t       tick;
+        uint16_t        t[2];
+    } now;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now.t[0] = TICKS_HR_TCB.CNT;
+        now.t[1] = hr_h;
+        // Counter wrapped, but interrupt not serviced yet
+        if ((TICKS_HR_TCB.INTFLAGS & TCB_CAPT_bm) && now.t[0] < 0x8000)
+            now.t[1]++;
+    }
+
+    return now.tick;
+}
+
+hrticks_t ticks_hr_elapsed(hrticks_t t0)
+{
+    return ticks_hr_get() - t0;
+}
+
+void ticks_update(void)
+{
+    hrticks_t       hr = ticks_hr_get();
+
+    if (hr - hr_snapshot > loop_max)
+        loop_max = hr - hr_snapshot;
+    hr_snapshot = hr;
+    now_snapshot = ticks_get();
+    loop_cnt++;
+}
+
+ticks_t ticks_now(void)
+{
+#ifdef TICKS_NOW_PRECISE
+    return ticks_get();
+#else
+    return now_snapshot;
+#endif
+}
+
+ticks_t ticks_now_elapsed(ticks_t t0)
+{
+    return ticks_now() - t0;
+}
+
+uint32_t ticks_loop_stat(hrticks_t *max)
+{
+    uint32_t        cnt = loop_cnt;
+
+    *max = loop_max;
+    loop_cnt = 0;
+    loop_max = 0;
+    return cnt;
+}
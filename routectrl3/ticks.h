@@ -18,8 +18,39 @@
 
 typedef uint32_t ticks_t;
 
+/*
+ * High resolution ticks. Counts CPU cycles using a TCB, extended to 32 bits.
+ * Wraps after about 179 seconds at 24 MHz.
+ */
+#define HRTICKS_PER_US  (F_CPU / 1000000UL)
+#define HRTICKS_TO_US(x) ((x) / HRTICKS_PER_US)
+
+typedef uint32_t hrticks_t;
+
 extern void     ticks_init(void);
 extern ticks_t  ticks_get(void);
 extern ticks_t  ticks_elapsed(ticks_t t0);
+extern hrticks_t ticks_hr_get(void);
+extern hrticks_t ticks_hr_elapsed(hrticks_t t0);
+
+/*
+ * Per mainloop time snapshot.
+ *
+ * ticks_update() is called once at the top of the mainloop. Update functions
+ * use ticks_now() and ticks_now_elapsed() instead of reading the RTC.
+ * ticks_get() is still available where precise time is needed.
+ * Define TICKS_NOW_PRECISE to make ticks_now() read the RTC (for comparison).
+ */
+extern void     ticks_update(void);
+extern ticks_t  ticks_now(void);
+extern ticks_t  ticks_now_elapsed(ticks_t t0);
+
+/*
+ * Mainloop statistics, collected by ticks_update().
+ *
+ * @param max Returns longest loop iteration in hrticks since last call.
+ * @return    Number of loop iterations since last call.
+ */
+extern uint32_t ticks_loop_stat(hrticks_t *max);
 
 #endif /* TICKS_H_ */
@@ -1,106 +1,355 @@
 /*
  * timer.c
  *
+ * Hierarchical timing wheel with a static timer pool.
+ *
+ * Three levels of 64 slots, each with 1, 64 and 4096 ticks resolution,
+ * covering 256 seconds. Longer timers are parked in the last slot of the
+ * top level and reinserted when it cascades.
+ * Timers are linked in double linked lists using pool indexes, so add and
+ * cancel are O(1).
+ * Expired timers are moved to a list in deadline order, and drained by
+ * timer_update within a budget. Lateness is recorded per timer class.
+ *
  * Created: 10-05-2021 18:06:55
  *  Author: Mikael Ejberg Pedersen
  */
 
+#include <avr/pgmspace.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <stdlib.h>
+#include <stdio.h>
 #include "ticks.h"
 #include "timer.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#if TIMER_POOL_SIZE > 65534
+#error "TIMER_POOL_SIZE too large"
+#endif
 
+#define SLOT_BITS       6
+#define SLOTS           (1 << SLOT_BITS)
+#define SLOT_MASK       (SLOTS - 1)
+#define LEVELS          3
+#define LEVEL_TICKS(l)  (1UL << ((l) * SLOT_BITS))
 
-typedef struct timer_t_
+#if TIMER_POOL_SIZE > 254
+typedef uint16_t timer_idx_t;
+#define NIL             0xffff
+#define HANDLE_SHIFT    16
+#else
+typedef uint8_t timer_idx_t;
+#define NIL             0xff
+#define HANDLE_SHIFT    8
+#endif
+
+#define LIST_FREE       0xff
+#define LIST_EXPIRED    0xfe
+
+typedef struct
 {
-    struct timer_t_ *next;
+    timer_idx_t     next;
+    timer_idx_t     prev;
+    uint8_t         list;       // Wheel slot, LIST_FREE or LIST_EXPIRED
+    uint8_t         gen;        // Bumped on free to catch stale handles
+    uint8_t         cls;
     ticks_t         timeout;
     timer_cb       *cb;
     void           *ctx;
 } timer_t;
 
-static timer_t *head = NULL;
+static timer_t  pool[TIMER_POOL_SIZE];
+static timer_idx_t wheel[LEVELS * SLOTS];
+static timer_idx_t free_head = NIL;
+static timer_idx_t exp_head = NIL;
+static timer_idx_t exp_tail = NIL;
+
+static ticks_t  wheel_time;     // Next tick to process
+static timer_idx_t used = 0;
+static timer_idx_t used_peak = 0;
+static uint16_t alloc_fail = 0;
+
+typedef struct
+{
+    uint16_t        fired;
+    uint32_t        late_sum;
+    ticks_t         late_max;
+} timer_late_t;
+
+static timer_late_t late[TIMER_CLASS_CNT];
+
+
+static timer_idx_t *list_head(uint8_t list)
+{
+    if (list == LIST_EXPIRED)
+        return &exp_head;
+    return &wheel[list];
+}
+
+static void list_unlink(timer_idx_t i)
+{
+    timer_t        *t = &pool[i];
+
+    if (t->prev != NIL)
+        pool[t->prev].next = t->next;
+    else
+        *list_head(t->list) = t->next;
 
+    if (t->next != NIL)
+        pool[t->next].prev = t->prev;
+    else if (t->list == LIST_EXPIRED)
+        exp_tail = t->prev;
+}
 
-int8_t timer_add(ticks_t timeout, timer_cb *cb, void *ctx)
+static void list_push(timer_idx_t i, uint8_t list)
 {
-    timer_t        *p, *t;
+    timer_idx_t    *head = list_head(list);
+
+    pool[i].list = list;
+    pool[i].prev = NIL;
+    pool[i].next = *head;
+    if (*head != NIL)
+        pool[*head].prev = i;
+    *head = i;
+}
 
-    t = malloc(sizeof(*t));
-    if (!t)
-        return -1;
+static void expired_append(timer_idx_t i)
+{
+    pool[i].list = LIST_EXPIRED;
+    pool[i].next = NIL;
+    pool[i].prev = exp_tail;
+    if (exp_tail != NIL)
+        pool[exp_tail].next = i;
+    else
+        exp_head = i;
+    exp_tail = i;
+}
 
-    timeout += ticks_get();
-    t->timeout = timeout;
-    t->cb = cb;
-    t->ctx = ctx;
+static void wheel_insert(timer_idx_t i)
+{
+    ticks_t         timeout = pool[i].timeout;
+    ticks_t         delta = timeout - wheel_time;
+    uint8_t         slot;
 
-    if (!head)                  // No timers in list
+    if (delta & 0x80000000)
     {
-        head = t;
-        head->next = NULL;
-        return 0;
+        // Already due. Expire on next tick processed
+        timeout = wheel_time;
+        delta = 0;
     }
 
-    if (!((head->timeout - timeout) & 0x80000000))
+    if (delta < LEVEL_TICKS(1))
+        slot = timeout & SLOT_MASK;
+    else if (delta < LEVEL_TICKS(2))
+        slot = SLOTS + ((timeout >> SLOT_BITS) & SLOT_MASK);
+    else if (delta < LEVEL_TICKS(3))
+        slot = 2 * SLOTS + ((timeout >> (2 * SLOT_BITS)) & SLOT_MASK);
+    else                        // Beyond wheel range. Park in top level slot cascading last
+        slot = 2 * SLOTS + (((wheel_time >> (2 * SLOT_BITS)) + SLOT_MASK) & SLOT_MASK);
+
+    list_push(i, slot);
+}
+
+static void wheel_cascade(uint8_t slot)
+{
+    timer_idx_t     i = wheel[slot];
+
+    wheel[slot] = NIL;
+    while (i != NIL)
     {
-        // New timer is shorter than timer in head. Put new timer first
-        t->next = head;
-        head = t;
-        return 0;
+        timer_idx_t     next = pool[i].next;
+
+        wheel_insert(i);
+        i = next;
     }
+}
+
+static void wheel_step(void)
+{
+    timer_idx_t     i;
+
+    if ((wheel_time & (LEVEL_TICKS(2) - 1)) == 0)
+        wheel_cascade(2 * SLOTS + ((wheel_time >> (2 * SLOT_BITS)) & SLOT_MASK));
+    if ((wheel_time & (LEVEL_TICKS(1) - 1)) == 0)
+        wheel_cascade(SLOTS + ((wheel_time >> SLOT_BITS) & SLOT_MASK));
 
-    p = head;
-    while (p->next)
+    // Everything in level 0 slot is due now
+    i = wheel[wheel_time & SLOT_MASK];
+    wheel[wheel_time & SLOT_MASK] = NIL;
+    while (i != NIL)
     {
-        if (!((p->next->timeout - timeout) & 0x80000000))
-            break;
-        p = p->next;
+        timer_idx_t     next = pool[i].next;
+
+        expired_append(i);
+        i = next;
     }
+}
 
-    t->next = p->next;
-    p->next = t;
+static void timer_free(timer_idx_t i)
+{
+    pool[i].gen++;
+    pool[i].list = LIST_FREE;
+    pool[i].next = free_head;
+    free_head = i;
+    used--;
+}
 
-    return 0;
+
+void timer_init(void)
+{
+    timer_idx_t     i;
+
+    for (i = 0; i < LEVELS * SLOTS; i++)
+        wheel[i] = NIL;
+
+    for (i = 0; i < TIMER_POOL_SIZE; i++)
+    {
+        pool[i].list = LIST_FREE;
+        pool[i].next = (i + 1 < TIMER_POOL_SIZE) ? i + 1 : NIL;
+    }
+    free_head = 0;
+
+    wheel_time = ticks_get();
 }
 
-void timer_delete(void *ctx)
+timer_handle_t timer_add(ticks_t timeout, timer_cb *cb, void *ctx)
+{
+    return timer_add_class(timeout, cb, ctx, TIMER_CLASS_GENERIC);
+}
+
+timer_handle_t timer_add_class(ticks_t timeout, timer_cb *cb, void *ctx, timer_class_t cls)
 {
-    timer_t       **p = &head;
+    timer_idx_t     i = free_head;
 
-    while (*p)
+    if (i == NIL)
     {
-        if ((*p)->ctx == ctx)
-        {
-            timer_t        *q = *p;
+        alloc_fail++;
+        return TIMER_HANDLE_INVALID;
+    }
+    free_head = pool[i].next;
+    if (++used > used_peak)
+        used_peak = used;
 
-            *p = q->next;
-            free(q);
-        }
-        else
+    pool[i].timeout = ticks_get() + timeout;
+    pool[i].cb = cb;
+    pool[i].ctx = ctx;
+    pool[i].cls = cls;
+    wheel_insert(i);
+
+    return ((timer_handle_t) pool[i].gen << HANDLE_SHIFT) | (i + 1);
+}
+
+void timer_cancel(timer_handle_t h)
+{
+    timer_idx_t     i = (timer_idx_t) h - 1;
+
+    if (i >= TIMER_POOL_SIZE)
+        return;
+    if (pool[i].list == LIST_FREE || pool[i].gen != (uint8_t) (h >> HANDLE_SHIFT))
+        return;                 // Stale handle
+
+    list_unlink(i);
+    timer_free(i);
+}
+
+void timer_delete(void *ctx)
+{
+    timer_idx_t     i;
+
+    for (i = 0; i < TIMER_POOL_SIZE; i++)
+    {
+        if (pool[i].list != LIST_FREE && pool[i].ctx == ctx)
         {
-            p = &((*p)->next);
+            list_unlink(i);
+            timer_free(i);
         }
     }
 }
 
+static void record_lateness(timer_idx_t i)
+{
+    timer_late_t   *l = &late[pool[i].cls];
+    ticks_t         t = ticks_get() - pool[i].timeout;
+
+    if (t & 0x80000000)         // Parked due timer fired at its deadline
+        t = 0;
+    l->fired++;
+    l->late_sum += t;
+    if (t > l->late_max)
+        l->late_max = t;
+}
+
 void timer_update(void)
 {
-    timer_t        *p;
+    ticks_t         now = ticks_now();
+    timer_cb       *cb;
+    void           *ctx;
+    timer_idx_t     i;
+    uint8_t         budget;
 
-    if (!head)
+    if (used == 0)
+    {
+        wheel_time = now + 1;
         return;
+    }
 
-    if ((ticks_get() - head->timeout) & 0x80000000)
-        return;
+    while (!((now - wheel_time) & 0x80000000))
+    {
+        wheel_step();
+        wheel_time++;
+    }
+
+    for (budget = TIMER_UPDATE_BUDGET; budget; budget--)
+    {
+        i = exp_head;
+        if (i == NIL)
+            return;
 
-    // Remove timer from list
-    p = head;
-    head = head->next;
+        // Remove timer from list before callback, so it may add new timers
+        list_unlink(i);
+        record_lateness(i);
+        cb = pool[i].cb;
+        ctx = pool[i].ctx;
+        timer_free(i);
 
-    // Timeout callback
-    p->cb(p->ctx);
+        // Timeout callback
+        cb(ctx);
+    }
+}
 
-    free(p);
+uint16_t timer_used(void)
+{
+    return used;
 }
+
+
+static void timerCmd(uint8_t argc, char *argv[])
+{
+    static const char class_name[TIMER_CLASS_CNT][8] PROGMEM = { "generic", "rtdelay" };
+    uint8_t         c;
+
+    if (argc >= 2 && argv[1][0] == 'r')
+    {
+        for (c = 0; c < TIMER_CLASS_CNT; c++)
+        {
+            late[c].fired = 0;
+            late[c].late_sum = 0;
+            late[c].late_max = 0;
+        }
+        used_peak = used;
+        alloc_fail = 0;
+        return;
+    }
+
+    printf_P(PSTR("Timers used: %u of %u\n"), used, TIMER_POOL_SIZE);
+    printf_P(PSTR("Peak used:   %u\n"), used_peak);
+    printf_P(PSTR("Alloc fails: %u\n"), alloc_fail);
+    printf_P(PSTR("Class    Fired  Avg late  Max late (ticks)\n"));
+    for (c = 0; c < TIMER_CLASS_CNT; c++)
+    {
+        printf_P(PSTR("%-7S %6u %9lu %9lu\n"), class_name[c], late[c].fired,
+                 late[c].fired ? late[c].late_sum / late[c].fired : 0UL, late[c].late_max);
+    }
+}
+
+CMD(timer, "Timer pool status. 'timer r' resets statistics");
@@ -12,11 +12,98 @@
 #include <stdint.h>
 #include "ticks.h"
 
+// 13 bytes of SRAM per timer. Route delays take one each, leave room for other users.
+// Pools above 254 timers use 16 bit indexes and 32 bit handles
+#ifndef TIMER_POOL_SIZE
+#define TIMER_POOL_SIZE 80
+#endif
+
+// Max number of expired timers fired per timer_update
+#ifndef TIMER_UPDATE_BUDGET
+#define TIMER_UPDATE_BUDGET 16
+#endif
+
+#define TIMER_HANDLE_INVALID 0
 
 typedef void    (timer_cb) (void *);
+#if TIMER_POOL_SIZE > 254
+typedef uint32_t timer_handle_t;
+#else
+typedef uint16_t timer_handle_t;
+#endif
+
+/**
+ * Timer classes. Lateness statistics are kept per class.
+ */
+typedef enum
+{
+    TIMER_CLASS_GENERIC,
+    TIMER_CLASS_ROUTE_DELAY,
+    TIMER_CLASS_CNT
+} timer_class_t;
+
+
+/**
+ * Init timer module.
+ *
+ * Call once at startup.
+ */
+extern void     timer_init(void);
+
+/**
+ * Add a timer.
+ *
+ * Timers are taken from a static pool. No heap is used.
+ *
+ * @param timeout Timeout in ticks.
+ * @param cb      Timeout function callback.
+ * @param ctx     Context passed to callback.
+ * @return        Timer handle, or TIMER_HANDLE_INVALID if pool is exhausted.
+ */
+extern timer_handle_t timer_add(ticks_t timeout, timer_cb *cb, void *ctx);
+
+/**
+ * Add a timer of a specific class.
+ *
+ * @param timeout Timeout in ticks.
+ * @param cb      Timeout function callback.
+ * @param ctx     Context passed to callback.
+ * @param cls     Timer class.
+ * @return        Timer handle, or TIMER_HANDLE_INVALID if pool is exhausted.
+ */
+extern timer_handle_t timer_add_class(ticks_t timeout, timer_cb *cb, void *ctx, timer_class_t cls);
 
-extern int8_t   timer_add(ticks_t timeout, timer_cb *cb, void *ctx);
+/**
+ * Cancel a timer.
+ *
+ * Cancelling an already expired or cancelled timer does nothing.
+ *
+ * @param h Timer handle returned by timer_add.
+ */
+extern void     timer_cancel(timer_handle_t h);
+
+/**
+ * Delete all timers with the given context.
+ *
+ * Slower than timer_cancel, as the whole pool is searched.
+ *
+ * @param ctx Context given to timer_add.
+ */
 extern void     timer_delete(void *ctx);
+
+/**
+ * Update timer module.
+ *
+ * Fires all expired timers in deadline order, up to TIMER_UPDATE_BUDGET.
+ * Call regularly from mainloop.
+ */
 extern void     timer_update(void);
 
+/**
+ * Get number of timers in use.
+ *
+ * @return Timers in use.
+ */
+extern uint16_t timer_used(void);
+
 #endif /* TIMER_H_ */
@@ -0,0 +1,183 @@
+/*
+ * trace.c
+ *
+ * Binary event trace.
+ *
+ * Created: 19-10-2026 13:05:30
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ticks.h"
+#include "trace.h"
+#include "lib/avr-shell-cmd/cmd.h"
+
+#if TRACE_BUF_RECS & (TRACE_BUF_RECS - 1)
+#error "TRACE_BUF_RECS must be power of 2"
+#endif
+
+#ifdef ROUTE_DEBUG
+#define TRACE_DEFAULT_LEVEL TRACE_DEBUG
+#define TRACE_DEFAULT_STREAM true
+#else
+#define TRACE_DEFAULT_LEVEL TRACE_INFO
+#define TRACE_DEFAULT_STREAM false
+#endif
+
+typedef struct
+{
+    uint8_t         ev;
+    uint16_t        t;
+    uint16_t        a;
+    uint16_t        b;
+} __attribute__((packed)) trace_rec_t;
+
+uint8_t         trace_level[TRACE_MOD_CNT] = {[0 ... TRACE_MOD_CNT - 1] = TRACE_DEFAULT_LEVEL };
+
+static trace_rec_t buf[TRACE_BUF_RECS];
+static uint8_t  buf_widx = 0;
+static uint8_t  buf_ridx = 0;
+static uint16_t lost = 0;
+static uint16_t lost_t;         // Time of first lost event
+static ticks_t  sync_t;
+static bool     sync_due = true;
+static bool     stream = TRACE_DEFAULT_STREAM;
+
+
+static uint8_t buf_free(void)
+{
+    return (buf_ridx - buf_widx - 1) & (TRACE_BUF_RECS - 1);
+}
+
+static void buf_put(uint8_t ev, uint16_t t, uint16_t a, uint16_t b)
+{
+    trace_rec_t    *r = &buf[buf_widx];
+
+    r->ev = ev;
+    r->t = t;
+    r->a = a;
+    r->b = b;
+    buf_widx = (buf_widx + 1) & (TRACE_BUF_RECS - 1);
+}
+
+static void lose(ticks_t now)
+{
+    if (lost == 0)
+        lost_t = now;
+    if (lost < UINT16_MAX)
+        lost++;
+}
+
+
+void trace_put(uint8_t ev, uint16_t a, uint16_t b)
+{
+    ticks_t         now = ticks_now();
+
+    if (lost)
+    {
+        // Mark the gap where it happened, followed by a sync as the lost records may include one
+        if (buf_free() < 3)
+        {
+            lose(now);
+            return;
+        }
+        buf_put(TRACE_EV_OVERFLOW, lost_t, lost, 0);
+        lost = 0;
+        sync_due = true;
+    }
+
+    if (sync_due || now - sync_t >= TRACE_SYNC_TICKS)
+    {
+        if (buf_free() < 2)
+        {
+            lose(now);
+            return;
+        }
+        buf_put(TRACE_EV_SYNC, now, now & 0xffff, now >> 16);
+        sync_t = now;
+        sync_due = false;
+    }
+
+    if (buf_free() < 1)
+    {
+        lose(now);
+        return;
+    }
+    buf_put(ev, now, a, b);
+}
+
+
+bool trace_streaming(void)
+{
+    return stream;
+}
+
+
+bool trace_get(uint8_t *rec)
+{
+    if (buf_ridx == buf_widx && lost)
+    {
+        // Buffer drained with no event since the gap. Mark it after the records before it
+        trace_rec_t     r = {.ev = TRACE_EV_OVERFLOW,.t = lost_t,.a = lost,.b = 0 };
+
+        memcpy(rec, &r, TRACE_REC_LEN);
+        lost = 0;
+        sync_due = true;
+        return true;
+    }
+
+    if (buf_ridx == buf_widx)
+        return false;
+
+    memcpy(rec, &buf[buf_ridx], TRACE_REC_LEN);
+    buf_ridx = (buf_ridx + 1) & (TRACE_BUF_RECS - 1);
+    return true;
+}
+
+
+static const char mod_names[TRACE_MOD_CNT][6] PROGMEM = { "route", "queue", "delay" };
+
+static void traceCmd(uint8_t argc, char *argv[])
+{
+    uint8_t         m;
+
+    if (argc < 2)
+    {
+        printf_P(PSTR("Usage: trace s <0|1>        : Stream off/on\n"));
+        printf_P(PSTR("       trace <mod> <level>  : Set level (0-3)\n"));
+        printf_P(PSTR("Stream: %S\n"), stream ? PSTR("on") : PSTR("off"));
+        for (m = 0; m < TRACE_MOD_CNT; m++)
+            printf_P(PSTR("%-5S: %u\n"), mod_names[m], trace_level[m]);
+        return;
+    }
+
+    if (argc < 3)
+    {
+        printf_P(PSTR("Missing argument\n"));
+        return;
+    }
+
+    if (!strcmp_P(argv[1], PSTR("s")))
+    {
+        stream = strtoul(argv[2], NULL, 0) != 0;
+        sync_due = true;        // Decoder may start here
+        return;
+    }
+
+    for (m = 0; m < TRACE_MOD_CNT; m++)
+    {
+        if (!strcmp_P(argv[1], mod_names[m]))
+        {
+            trace_level[m] = strtoul(argv[2], NULL, 0);
+            return;
+        }
+    }
+    printf_P(PSTR("Unknown module\n"));
+}
+
+CMD(trace, "Event trace");
@@ -0,0 +1,109 @@
+/*
+ * trace.h
+ *
+ * Binary event trace.
+ * Events are written to a RAM ring buffer and streamed out of the terminal
+ * UART when it is idle. Decode with tools/trace_decode.py.
+ *
+ * Created: 19-10-2026 13:05:17
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ticks.h"
+
+#ifndef TRACE_BUF_RECS
+#define TRACE_BUF_RECS  32      // Must be power of 2
+#endif
+
+// Streamed frame: TRACE_FRAME_START followed by a record, escaped (see term.h)
+#define TRACE_FRAME_START 0xF0
+#define TRACE_REC_LEN   7       // Event id, ticks (16 bit), a, b. Little endian
+
+// A TRACE_EV_SYNC record with the full ticks is put before an event when
+// this long has passed since the last one, so the 16 bit ticks decode
+// across quiet periods and lost records
+#define TRACE_SYNC_TICKS TICKS_FROM_SEC(16)
+
+typedef enum
+{
+    TRACE_MOD_ROUTE,
+    TRACE_MOD_ROUTE_QUEUE,
+    TRACE_MOD_ROUTE_DELAY,
+    TRACE_MOD_CNT
+} trace_mod_t;
+
+typedef enum
+{
+    TRACE_OFF,
+    TRACE_ERROR,
+    TRACE_INFO,
+    TRACE_DEBUG
+} trace_level_t;
+
+/*
+ * Event ids.
+ * tools/trace_decode.py reads the names from this enum. Only append.
+ */
+typedef enum
+{
+    TRACE_EV_OVERFLOW,          // a: Lost events
+    TRACE_EV_ROUTE_REQUEST,     // a: Route
+    TRACE_EV_ROUTE_ACTIVATE,    // a: Route
+    TRACE_EV_ROUTE_FREE,        // a: Route
+    TRACE_EV_ROUTE_CANCEL,      // a: Route
+    TRACE_EV_ROUTE_FORCE,       // a: Route
+    TRACE_EV_ROUTE_KILL,        // a: Route
+    TRACE_EV_SEND_SW,           // a: Switch address, b: 1 = G, 0 = R
+    TRACE_EV_SEND_FB,           // a: Feedback address, b: 1 = occupied, 0 = free
+    TRACE_EV_SEND_SW_PRIO,      // a: Switch address, b: 1 = G, 0 = R
+    TRACE_EV_SEND_FB_PRIO,      // a: Feedback address, b: 1 = occupied, 0 = free
+    TRACE_EV_DELAY_ADD,         // a: Route, b: Seconds
+    TRACE_EV_DELAY_CANCEL,      // a: Route
+    TRACE_EV_DELAY_TIMEOUT,     // a: Route
+    TRACE_EV_SYNC,              // a: Ticks low 16 bits, b: Ticks high 16 bits
+    TRACE_EV_RQ_DROP,           // a: Address, b: Route queue command. Route queue full
+    TRACE_EV_SWQ_DROP           // a: Switch address, b: 1 = G, 0 = R. Switch queue full
+} trace_ev_t;
+
+extern uint8_t  trace_level[TRACE_MOD_CNT];
+
+/**
+ * Trace an event.
+ *
+ * The level check is inlined, so disabled events cost a load and a compare.
+ *
+ * @param mod Module (trace_mod_t).
+ * @param lvl Level of event (trace_level_t).
+ * @param ev  Event id (trace_ev_t).
+ * @param a   First argument.
+ * @param b   Second argument.
+ */
+#define TRACE(mod, lvl, ev, a, b) \
+    do { if (trace_level[mod] >= (lvl)) trace_put((ev), (a), (b)); } while (0)
+
+/**
+ * Put an event in trace buffer. Use TRACE() instead.
+ */
+extern void     trace_put(uint8_t ev, uint16_t a, uint16_t b);
+
+/**
+ * Get trace streaming state.
+ *
+ * @return True if trace records should be streamed.
+ */
+extern bool     trace_streaming(void);
+
+/**
+ * Get next record from trace buffer.
+ *
+ * @param rec Buffer for TRACE_REC_LEN bytes.
+ * @return    True if a record was returned.
+ */
+extern bool     trace_get(uint8_t *rec);
+
+#endif /* TRACE_H_ */
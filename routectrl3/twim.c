@@ -2,7 +2,7 @@
  * twim.c
  *
  * TWI master driver for AVR DA.
- * Interrupt driven.
+ * Interrupt driven, with a small queue of pending transactions.
  * Not tested in a multi-master setup.
  *
  * Created: 21-09-2025 12:58:20
@@ -17,7 +17,27 @@
 #include "twim.h"
 
 
-#define TWI_BAUD 115            // 115 = 100 kHz. 27 = 400 kHz. Only valid if F_CPU is 24 MHz
+#ifndef TWI_FREQ
+#define TWI_FREQ 100000UL       // SCL frequency. 100 kHz. Define 400000UL (fast mode) or 1000000UL (fast mode plus) if the bus allows
+#endif
+
+#ifndef TWI_RISE_NS             // SCL rise time, depends on bus capacitance and pull-ups
+#if TWI_FREQ > 400000UL
+#define TWI_RISE_NS 120
+#elif TWI_FREQ > 100000UL
+#define TWI_RISE_NS 300
+#else
+#define TWI_RISE_NS 1000
+#endif
+#endif
+
+#define TWI_BAUD (F_CPU / (2 * TWI_FREQ) - 5 - (F_CPU / 1000000UL) * TWI_RISE_NS / 2000)
+
+#if TWI_FREQ > 1000000UL || F_CPU / (2 * TWI_FREQ) < 5 + (F_CPU / 1000000UL) * TWI_RISE_NS / 2000 || TWI_BAUD > 255
+#error TWI_FREQ not possible with this F_CPU
+#endif
+
+#define QUEUE_SIZE 4            // Must be power of 2
 
 typedef enum
 {
@@ -27,21 +47,39 @@ typedef enum
     TWIM_STATE_RDATA
 } twim_state_t;
 
+typedef struct
+{
+    uint8_t         adr;
+    const uint8_t  *wbuf;
+    uint16_t        wlen;
+    uint8_t        *rbuf;
+    uint16_t        rlen;
+    twim_cb        *cb;
+} twim_trans_t;
+
+
+static twim_trans_t queue[QUEUE_SIZE];
+static uint8_t  queue_widx = 0;
+static uint8_t  queue_ridx = 0;
+static bool     active = false;         // Transaction at queue_ridx has been started
 
-static twim_cb *callback = NULL;
 static const uint8_t *pwbuf;
 static uint8_t *prbuf;
 static uint16_t wcount, rcount;
 static uint8_t  radr;
 static twim_status_t twi_status;
-static twim_state_t twi_state = TWIM_STATE_IDLE;
+static volatile twim_state_t twi_state = TWIM_STATE_IDLE;
 
 
 void twim_init(void)
 {
     // Init port pins (Errata 2.12.1: Clear port pins before enabling twi)
     PORTA.OUTCLR = PIN2_bm | PIN3_bm;
+#if TWI_FREQ > 400000UL
+    TWI0.CTRLA = TWI_FMPEN_bm;  // I2C mode, fast mode plus
+#else
     TWI0.CTRLA = 0;             // I2C mode, no fast mode plus
+#endif
     TWI0.DUALCTRL = 0;
     TWI0.MBAUD = TWI_BAUD;
     TWI0.MCTRLA = TWI_RIEN_bm | TWI_WIEN_bm | TWI_ENABLE_bm;
@@ -49,63 +87,81 @@ void twim_init(void)
 }
 
 
+static void start_next(void)
+{
+    const twim_trans_t *t = &queue[queue_ridx];
+
+    if (active || queue_ridx == queue_widx || (TWI0.MSTATUS & TWI_BUSSTATE_gm) != TWI_BUSSTATE_IDLE_gc)
+        return;
+
+    active = true;
+    pwbuf = t->wbuf;
+    prbuf = t->rbuf;
+    wcount = t->wlen;
+    rcount = t->rlen;
+    radr = t->adr | 0x01;
+    twi_state = TWIM_STATE_WADR;
+    if (wcount || !rcount)
+        TWI0.MADDR = t->adr & 0xfe;
+    else
+        TWI0.MADDR = radr;
+}
+
+
 void twim_update(void)
 {
-    if (callback && twi_state == TWIM_STATE_IDLE)
+    if (active && twi_state == TWIM_STATE_IDLE)
     {
-        callback(twi_status);
-        callback = NULL;
+        twim_cb        *cb = queue[queue_ridx].cb;
+
+        active = false;
+        queue_ridx = (queue_ridx + 1) & (QUEUE_SIZE - 1);
+        if (cb)
+            cb(twi_status);
     }
+    start_next();
 }
 
 
 bool twim_ready(void)
 {
-    return callback == NULL && (TWI0.MSTATUS & TWI_BUSSTATE_gm) == TWI_BUSSTATE_IDLE_gc;
+    return ((queue_widx + 1) & (QUEUE_SIZE - 1)) != queue_ridx;
 }
 
 
-bool twim_write(uint8_t adr, const uint8_t *buf, uint16_t len, twim_cb *cb)
+static bool enqueue(uint8_t adr, const uint8_t *wbuf, uint16_t wlen, uint8_t *rbuf, uint16_t rlen, twim_cb *cb)
 {
+    twim_trans_t   *t = &queue[queue_widx];
+
     if (!twim_ready())
         return false;
-    callback = cb;
-    pwbuf = buf;
-    wcount = len;
-    rcount = 0;
-    twi_state = TWIM_STATE_WADR;
-    TWI0.MADDR = adr & 0xfe;
+    t->adr = adr;
+    t->wbuf = wbuf;
+    t->wlen = wlen;
+    t->rbuf = rbuf;
+    t->rlen = rlen;
+    t->cb = cb;
+    queue_widx = (queue_widx + 1) & (QUEUE_SIZE - 1);
+    start_next();
     return true;
 }
 
 
+bool twim_write(uint8_t adr, const uint8_t *buf, uint16_t len, twim_cb *cb)
+{
+    return enqueue(adr, buf, len, NULL, 0, cb);
+}
+
+
 bool twim_read(uint8_t adr, uint8_t *buf, uint16_t len, twim_cb *cb)
 {
-    if (!twim_ready())
-        return false;
-    callback = cb;
-    prbuf = buf;
-    wcount = 0;
-    rcount = len;
-    twi_state = TWIM_STATE_WADR;
-    TWI0.MADDR = adr | 0x01;
-    return true;
+    return enqueue(adr, NULL, 0, buf, len, cb);
 }
 
 
 bool twim_write_read(uint8_t adr, const uint8_t *wbuf, uint16_t wlen, uint8_t *rbuf, uint16_t rlen, twim_cb *cb)
 {
-    if (!twim_ready())
-        return false;
-    callback = cb;
-    pwbuf = wbuf;
-    prbuf = rbuf;
-    wcount = wlen;
-    rcount = rlen;
-    radr = adr | 0x01;
-    twi_state = TWIM_STATE_WADR;
-    TWI0.MADDR = adr & 0xfe;
-    return true;
+    return enqueue(adr, wbuf, wlen, rbuf, rlen, cb);
 }
 
 
@@ -2,7 +2,8 @@
  * twim.h
  *
  * TWI master driver for AVR DA.
- * Interrupt driven.
+ * Interrupt driven, with a small queue of pending transactions.
+ * SCL frequency is set with TWI_FREQ (default 100 kHz, 400 kHz or 1 MHz if the bus allows).
  * Not tested in a multi-master setup.
  *
  * Created: 21-09-2025 12:58:08
@@ -30,7 +31,8 @@ typedef enum
 /**
  * TWIM callback function prototype.
  *
- * NOTE: Do NOT start a new TWI read or write from within this callback.
+ * Called from twim_update() when the transaction is done.
+ * A new TWI read or write may be queued from within this callback.
  */
 typedef void    (twim_cb) (twim_status_t);
 
@@ -50,9 +52,9 @@ extern void     twim_init(void);
 extern void     twim_update(void);
 
 /**
- * TWIM ready or busy.
+ * TWIM queue has room.
  *
- * @return      True if ready for a new transaction.
+ * @return      True if a new transaction can be queued.
  */
 extern bool     twim_ready(void);
 
@@ -62,9 +64,9 @@ extern bool     twim_ready(void);
  * @param adr   Address (8-bit, already left-shifted).
  * @param buf   Ptr to data to write. Must be available until callback is called.
  * @param len   Length of data to write.
- * @param cb    Function callback with status when transaction is done.
+ * @param cb    Function callback with status when transaction is done. NULL if not used.
  *
- * @return      True if started successfully (wait for callback), false if not (no callback).
+ * @return      True if queued (wait for callback), false if queue is full (no callback).
  */
 extern bool     twim_write(uint8_t adr, const uint8_t *buf, uint16_t len, twim_cb *cb);
 
@@ -72,11 +74,11 @@ extern bool     twim_write(uint8_t adr, const uint8_t *buf, uint16_t len, twim_c
  * Read data from TWI
  *
  * @param adr   Address (8-bit, already left-shifted).
- * @param buf   Ptr for received data.
+ * @param buf   Ptr for received data. Must be available until callback is called.
  * @param len   Length of data to receive.
- * @param cb    Function callback with status when transaction is done.
+ * @param cb    Function callback with status when transaction is done. NULL if not used.
  *
- * @return      True if started successfully (wait for callback), false if not (no callback).
+ * @return      True if queued (wait for callback), false if queue is full (no callback).
  */
 extern bool     twim_read(uint8_t adr, uint8_t *buf, uint16_t len, twim_cb *cb);
 
@@ -86,11 +88,11 @@ extern bool     twim_read(uint8_t adr, uint8_t *buf, uint16_t len, twim_cb *cb);
  * @param adr   Address (8-bit, already left-shifted).
  * @param wbuf  Ptr to data to write. Must be available until callback is called.
  * @param wlen  Length of data to write.
- * @param rbuf  Ptr for received data.
+ * @param rbuf  Ptr for received data. Must be available until callback is called.
  * @param rlen  Length of data to receive.
- * @param cb    Function callback with status when transaction is done.
+ * @param cb    Function callback with status when transaction is done. NULL if not used.
  *
- * @return      True if started successfully (wait for callback), false if not (no callback).
+ * @return      True if queued (wait for callback), false if queue is full (no callback).
  */
 extern bool     twim_write_read(uint8_t adr, const uint8_t *wbuf, uint16_t wlen, uint8_t *rbuf, uint16_t rlen,
                                 twim_cb *cb);
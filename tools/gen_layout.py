@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+gen_layout.py
+
+Generate a synthetic layout (ROUTE(), FEEDBACK_OCC/FREE() and SWITCH_REQ()
+tables) of a given size, for scale testing of routectrl3.
+
+Each route gets a number of route and feedback constraints, and sets some
+switches when activated. A fraction of the routes free themselves after a
+delay (route_delay), the rest are freed by their feedback going free.
+Feedback occupied requests a route, and so does a switch request.
+
+Add the generated file to the project instead of the real layout, build
+with the defines printed in the file header, and run the 'perf' and
+'timer' commands (or tools/perf_log.py with --label) to collect
+numbers for each size. tools/host/bench.py generates and benchmarks
+layouts on the host.
+
+Usage:
+  gen_layout.py --routes 2000 --feedbacks 4000 --switches 1000 \\
+                --cstr 4 --fbcstr 2 --delays 0.1 -o layout_2000.c
+"""
+
+import argparse
+import random
+import sys
+
+CSTR_DATA_MAX = 0x0fff
+TIMER_POOL_OTHER = 16           # Timers besides route delays (timer.h default less route_delay.h default)
+
+
+def generate(args, out):
+    rnd = random.Random(args.seed)
+    routes, fbs, sws = args.routes, args.feedbacks, args.switches
+    delayed = set(rnd.sample(range(routes), int(routes * args.delays)))
+
+    if routes - 1 > CSTR_DATA_MAX or fbs > CSTR_DATA_MAX:
+        sys.exit("Routes and feedbacks must fit in a constraint (max %u)" % CSTR_DATA_MAX)
+
+    w = out.write
+    w("/*\n")
+    w(" * Synthetic layout generated by tools/gen_layout.py\n")
+    w(" *   %s\n" % " ".join(sys.argv[1:]))
+    w(" *\n")
+    w(" * Build with:\n")
+    w(" *   MAXROUTES=%u FEEDBACK_ADR_MAX=%u SW_ADR_MAX=%u\n" % (routes, max(fbs, 8), max(sws, 8)))
+    w(" *   ROUTE_DELAY_POOL_SIZE=%u TIMER_POOL_SIZE=%u\n" % (max(len(delayed), 1), len(delayed) + TIMER_POOL_OTHER))
+    w(" */\n\n")
+    w("#include <stdbool.h>\n#include <stdint.h>\n")
+    w('#include "fb_handler.h"\n#include "route.h"\n#include "route_delay.h"\n#include "sw_handler.h"\n\n')
+    w("#if MAXROUTES < %u\n#error \"MAXROUTES too small for this layout\"\n#endif\n\n" % routes)
+
+    w("static void delay_free(routenum_t num)\n{\n    route_free(num);\n}\n\n")
+    w("static void fb_occ(uint16_t adr)\n{\n    route_request((adr - 1) %% %u);\n}\n\n" % routes)
+    w("static void fb_free(uint16_t adr)\n{\n    route_free((adr - 1) %% %u);\n}\n\n" % routes)
+    w("static void sw_req(uint16_t adr, bool dir)\n{\n    if (dir)\n        route_request(adr %% %u);\n}\n\n" % routes)
+
+    for num in range(routes):
+        w("static void act%u(void)\n{\n" % num)
+        for _ in range(args.sw_per_route):
+            w("    route_send_sw(%u, %s);\n" % (rnd.randint(1, sws), rnd.choice(("true", "false"))))
+        if num in delayed:
+            w("    route_delay_add(%u, delay_free, %u);\n" % (rnd.randint(1, args.delay_max), num))
+        w("}\n\n")
+
+    for num in range(routes):
+        cstr = ["CSTR_RT(%u)" % c for c in rnd.sample(range(routes), min(args.cstr, routes)) if c != num]
+        cstr += ["CSTR_FB(%u)" % rnd.randint(1, fbs) for _ in range(args.fbcstr)]
+        w("ROUTE(%u, act%u, NULL, NULL%s)\n" % (num, num, "".join(", " + c for c in cstr)))
+    w("\n")
+
+    for adr in range(1, fbs + 1):
+        w("FEEDBACK_OCC(%u, fb_occ)\n" % adr)
+        w("FEEDBACK_FREE(%u, fb_free)\n" % adr)
+    w("\n")
+
+    for adr in range(1, sws + 1):
+        w("SWITCH_REQ(%u, sw_req)\n" % adr)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--routes", type=int, default=200, help="Number of routes")
+    ap.add_argument("--feedbacks", type=int, default=400, help="Number of feedback addresses")
+    ap.add_argument("--switches", type=int, default=200, help="Number of switch addresses")
+    ap.add_argument("--cstr", type=int, default=4, help="Route constraints per route")
+    ap.add_argument("--fbcstr", type=int, default=2, help="Feedback constraints per route")
+    ap.add_argument("--sw-per-route", type=int, default=4, help="Switches set per route activation")
+    ap.add_argument("--delays", type=float, default=0.1, help="Fraction of routes freed by a delay")
+    ap.add_argument("--delay-max", type=int, default=30, help="Max delay in seconds")
+    ap.add_argument("--seed", type=int, default=1, help="Random seed")
+    ap.add_argument("-o", "--output", default="-", help="Output file (default stdout)")
+    args = ap.parse_args()
+
+    if args.output == "-":
+        generate(args, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            generate(args, f)
+
+
+if __name__ == "__main__":
+    main()
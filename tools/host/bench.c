@@ -0,0 +1,235 @@
+/*
+ * bench.c
+ *
+ * Host benchmark of the route engine with a layout.
+ *
+ * Measures host CPU time of:
+ *  - A mainloop pass, idle, with routes waiting and with delays pending.
+ *  - Dispatch of a received OPC_INPUT_REP and OPC_SW_REQ.
+ *  - The table lookups of the 'bench' command.
+ *  - route_update(), average and worst case over the route numbers.
+ *  - Adding and canceling a route delay.
+ * Times are host nanoseconds, not AVR cycles. Compare runs on the same
+ * machine to find regressions. Prints one RESULT line for bench.py.
+ *
+ * route_update() checks one route number per call, so its cost depends on
+ * the route. Each route number is timed over several rounds and the
+ * fastest round is kept, which leaves out host noise (interrupts,
+ * preemption). The worst case is the slowest route number.
+ *
+ * Usage: bench <iterations> [delays]
+ *
+ * Created: 20-10-2026 13:20:51
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "fb_handler.h"
+#include "host_env.h"
+#include "route.h"
+#include "route_delay.h"
+#include "sw_handler.h"
+#include "timer.h"
+
+#define BENCH_FB_MAX    8192    // Feedback addresses dispatched
+#define BENCH_SW_MAX    8192    // Switch addresses dispatched
+#define BENCH_RU_ROUNDS 16      // Timed rounds over all route numbers
+#define BENCH_DELAY_SEC 3600    // Bench delays don't time out
+
+extern const route_table_t __loconet_routetable_start;
+extern const route_table_t __loconet_routetable_end;
+extern const feedback_table_t __loconet_fbocctable_start;
+extern const feedback_table_t __loconet_fbocctable_end;
+extern const feedback_table_t __loconet_fbfreetable_start;
+extern const feedback_table_t __loconet_fbfreetable_end;
+extern const switchreq_table_t __loconet_swreqtable_start;
+extern const switchreq_table_t __loconet_swreqtable_end;
+
+static uint16_t fbs[BENCH_FB_MAX];
+static uint16_t nfbs = 0;
+static uint16_t sws[BENCH_SW_MAX];
+static uint16_t nsws = 0;
+static uint64_t clock_cost = 0; // Cost of a host_clock_ns() pair
+static uint64_t ru_min[MAXROUTES];
+
+
+static void setup(void)
+{
+    const feedback_table_t *f;
+    const switchreq_table_t *s;
+
+    for (f = &__loconet_fbocctable_start; f < &__loconet_fbocctable_end && nfbs < BENCH_FB_MAX; f++)
+        fbs[nfbs++] = f->adr;
+    for (f = &__loconet_fbfreetable_start; f < &__loconet_fbfreetable_end && nfbs < BENCH_FB_MAX; f++)
+        fbs[nfbs++] = f->adr;
+    for (s = &__loconet_swreqtable_start; s < &__loconet_swreqtable_end && nsws < BENCH_SW_MAX; s++)
+        sws[nsws++] = s->adr;
+    if (nfbs == 0)
+        fbs[nfbs++] = 1;
+    if (nsws == 0)
+        sws[nsws++] = 1;
+}
+
+static void calibrate(void)
+{
+    uint64_t        t0 = host_clock_ns();
+    uint32_t        i;
+
+    for (i = 0; i < 10000; i++)
+        host_clock_ns();
+    clock_cost = (host_clock_ns() - t0) / 10000;
+}
+
+/*
+ * Mainloop pass cost. host_run() runs HOST_LOOPS_PER_TICK passes per tick.
+ */
+static double bench_loop(uint32_t n)
+{
+    uint64_t        t0 = host_clock_ns();
+
+    host_run(n / HOST_LOOPS_PER_TICK + 1);
+    return (double)(host_clock_ns() - t0) / ((n / HOST_LOOPS_PER_TICK + 1) * HOST_LOOPS_PER_TICK);
+}
+
+static double bench_fb(uint32_t n)
+{
+    uint64_t        t = 0, t0;
+    uint32_t        i;
+
+    for (i = 0; i < n; i++)
+    {
+        t0 = host_clock_ns();
+        host_rx_input_rep(fbs[i % nfbs], (i / nfbs) & 1);
+        t += host_clock_ns() - t0 - clock_cost;
+        if (i % 64 == 63)
+            host_run(1);        // Let the engine act on it, not timed
+    }
+    return (double)t / n;
+}
+
+static double bench_sw(uint32_t n)
+{
+    uint64_t        t = 0, t0;
+    uint32_t        i;
+
+    for (i = 0; i < n; i++)
+    {
+        t0 = host_clock_ns();
+        host_rx_sw_req(sws[i % nsws], (i / nsws) & 1, true);
+        t += host_clock_ns() - t0 - clock_cost;
+        if (i % 64 == 63)
+            host_run(1);
+    }
+    return (double)t / n;
+}
+
+/*
+ * Time of n calls of a lookup, less the clock.
+ */
+static double bench_lookup(hrticks_t (*fn)(uint16_t), uint16_t n)
+{
+    uint64_t        t0 = host_clock_ns();
+
+    fn(n);
+    return (double)(host_clock_ns() - t0 - clock_cost) / n;
+}
+
+static hrticks_t lookup_route(uint16_t n)
+{
+    return route_bench(ROUTE_BENCH_LOOKUP, n);
+}
+
+static hrticks_t lookup_cstr(uint16_t n)
+{
+    return route_bench(ROUTE_BENCH_CSTR, n);
+}
+
+/*
+ * route_update() per route number. Mainloop isn't run in between, so call
+ * i of a round is the same route number in each round.
+ */
+static void bench_route_update(double *avg, double *worst)
+{
+    uint64_t        t0, t, sum = 0;
+    uint16_t        i, r;
+
+    for (i = 0; i < MAXROUTES; i++)
+        ru_min[i] = UINT64_MAX;
+    for (r = 0; r < BENCH_RU_ROUNDS; r++)
+    {
+        for (i = 0; i < MAXROUTES; i++)
+        {
+            t0 = host_clock_ns();
+            route_update();
+            t = host_clock_ns() - t0 - clock_cost;
+            if (t < ru_min[i])
+                ru_min[i] = t;
+        }
+    }
+
+    *worst = 0;
+    for (i = 0; i < MAXROUTES; i++)
+    {
+        sum += ru_min[i];
+        if (ru_min[i] > *worst)
+            *worst = ru_min[i];
+    }
+    *avg = (double)sum / MAXROUTES;
+}
+
+static void delay_cb(routenum_t num)
+{
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t        n = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    uint16_t        delays = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+    uint16_t        lookups = n > UINT16_MAX ? UINT16_MAX : n;
+    const route_table_t *p;
+    double          loop_idle, loop_busy, loop_delays, fb, sw;
+    double          lookup, cstr, fbsearch, ru_avg, ru_worst, add, cancel;
+    uint16_t        i, timers;
+    uint64_t        t0;
+
+    host_init();
+    setup();
+    calibrate();
+
+    loop_idle = bench_loop(n);
+    lookup = bench_lookup(lookup_route, lookups);
+    cstr = bench_lookup(lookup_cstr, lookups);
+    fbsearch = bench_lookup(fb_handler_bench, lookups);
+    fb = bench_fb(n);
+    sw = bench_sw(n);
+
+    // Request all routes. The ones blocked by constraints are checked on each route_update()
+    for (p = &__loconet_routetable_start; p < &__loconet_routetable_end; p++)
+        route_request(p->routenum);
+    loop_busy = bench_loop(n);
+    bench_route_update(&ru_avg, &ru_worst);
+
+    // Delays on top of the ones the layout has pending
+    t0 = host_clock_ns();
+    for (i = 0; i < delays; i++)
+        route_delay_add(BENCH_DELAY_SEC, delay_cb, i % MAXROUTES);
+    add = delays ? (double)(host_clock_ns() - t0) / delays : 0;
+    timers = timer_used();
+    loop_delays = bench_loop(n);
+    t0 = host_clock_ns();
+    for (i = 0; i < delays && i < MAXROUTES; i++)
+        route_delay_cancel(i);
+    cancel = delays ? (double)(host_clock_ns() - t0) / i : 0;
+
+    printf("RESULT routes=%u fbs=%u sws=%u timers=%u"
+           " loop_idle_ns=%.1f loop_busy_ns=%.1f loop_delays_ns=%.1f fb_ns=%.1f sw_ns=%.1f"
+           " lookup_ns=%.1f cstr_ns=%.1f fbsearch_ns=%.1f ru_avg_ns=%.1f ru_worst_ns=%.1f"
+           " delay_add_ns=%.1f delay_cancel_ns=%.1f\n",
+           (unsigned)(&__loconet_routetable_end - &__loconet_routetable_start), nfbs, nsws, timers,
+           loop_idle, loop_busy, loop_delays, fb, sw, lookup, cstr, fbsearch, ru_avg, ru_worst, add, cancel);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+bench.py
+
+Host benchmark of the route engine (see bench.c).
+
+Builds bench.c with the route engine and a layout (see hostbuild.py),
+runs it and prints the cost of a mainloop pass, of dispatching a
+received packet, of the table lookups, of route_update() and of route
+delays. The numbers are host nanoseconds; they show the relative cost of
+a change and how it scales with the layout, not the time on the board
+(use perf_log.py for that, and for the flash and RAM footprint).
+
+Without layout files a layout is generated with gen_layout.py for each
+of --sizes (routes; twice as many feedbacks, as many switches), built
+with the defines the generator suggests. --delays adds pending route
+delays on top of the layout's own, and grows the pools to fit.
+
+With --csv a row per size is appended, labeled with git describe or
+--label, so results can be tracked from change to change.
+
+Usage:
+  bench.py [layout.c ...] [--sizes 200,1000,2000] [--delays 500]
+           [--iterations 100000] [--csv bench.csv] [--label name]
+  bench.py example/loop_layout.c
+"""
+
+import argparse
+import csv
+import datetime
+import os
+import subprocess
+import sys
+import tempfile
+
+import hostbuild
+
+GEN_LAYOUT = os.path.join(hostbuild.HOST_DIR, "..", "gen_layout.py")
+
+FIELDS = ["date", "label", "size", "routes", "fbs", "sws", "delays", "timers",
+          "loop_idle_ns", "loop_busy_ns", "loop_delays_ns", "fb_ns", "sw_ns",
+          "lookup_ns", "cstr_ns", "fbsearch_ns", "ru_avg_ns", "ru_worst_ns",
+          "delay_add_ns", "delay_cancel_ns"]
+
+
+def git_label():
+    try:
+        return subprocess.check_output(["git", "describe", "--always", "--dirty"],
+                                       cwd=hostbuild.HOST_DIR, universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def bench(args, layout, defines, tmp):
+    defines = dict(defines)
+    if args.delays:
+        # Bench delays come on top of the layout's (firmware defaults if not generated)
+        defines["ROUTE_DELAY_POOL_SIZE"] = str(int(defines.get("ROUTE_DELAY_POOL_SIZE", hostbuild.ROUTE_DELAY_POOL_SIZE))
+                                               + args.delays)
+        defines["TIMER_POOL_SIZE"] = str(int(defines.get("TIMER_POOL_SIZE", hostbuild.TIMER_POOL_SIZE)) + args.delays)
+    for d in args.defines:
+        k, _, v = d.partition("=")
+        defines[k] = v
+
+    exe = os.path.join(tmp, "bench")
+    hostbuild.build("bench.c", layout, exe, ["%s=%s" % kv for kv in sorted(defines.items())], args.cc)
+    out = subprocess.run([exe, str(args.iterations), str(args.delays)], stdout=subprocess.PIPE,
+                         universal_newlines=True, check=True).stdout
+    for line in out.splitlines():
+        if line.startswith("RESULT "):
+            return dict(f.split("=") for f in line.split()[1:])
+    sys.stdout.write(out)
+    sys.exit("No result")
+
+
+def report(r):
+    print("Layout:           %s routes, %s feedback entries, %s switch requests, %s timers in use"
+          % (r["routes"], r["fbs"], r["sws"], r["timers"]))
+    print("Mainloop pass:    %10s ns idle, %s ns busy, %s ns with delays"
+          % (r["loop_idle_ns"], r["loop_busy_ns"], r["loop_delays_ns"]))
+    for name, key in (("OPC_INPUT_REP:", "fb_ns"), ("OPC_SW_REQ:", "sw_ns")):
+        print("%-17s %10s ns, %.0f packets/s" % (name, r[key], 1e9 / max(float(r[key]), 1e-3)))
+    print("getrouteentry:    %10s ns" % r["lookup_ns"])
+    print("checkconstraints: %10s ns" % r["cstr_ns"])
+    print("feedback search:  %10s ns" % r["fbsearch_ns"])
+    print("route_update:     %10s ns avg, %s ns worst" % (r["ru_avg_ns"], r["ru_worst_ns"]))
+    print("Route delay:      %10s ns add, %s ns cancel" % (r["delay_add_ns"], r["delay_cancel_ns"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("layout", nargs="*", help="Layout C files (default: generated)")
+    ap.add_argument("--sizes", default="200", help="Routes of the generated layouts, comma separated")
+    ap.add_argument("--cstr", type=int, default=4, help="Route constraints per generated route")
+    ap.add_argument("--fbcstr", type=int, default=2, help="Feedback constraints per generated route")
+    ap.add_argument("--layout-seed", type=int, default=1, help="Seed of the generated layouts")
+    ap.add_argument("--delays", type=int, default=0, help="Route delays added by the benchmark")
+    ap.add_argument("--iterations", type=int, default=100000, help="Passes and packets measured")
+    ap.add_argument("-D", dest="defines", action="append", default=[], help="Firmware define, e.g. MAXROUTES=400")
+    ap.add_argument("--csv", help="CSV file to append results to")
+    ap.add_argument("--label", default=None, help="Label of this run (default: git describe)")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    args = ap.parse_args()
+
+    rows = []
+    with tempfile.TemporaryDirectory() as tmp:
+        if args.layout:
+            r = bench(args, [os.path.abspath(p) for p in args.layout], {}, tmp)
+            rows.append(("custom", r))
+        else:
+            for size in [int(s) for s in args.sizes.split(",")]:
+                layout = os.path.join(tmp, "layout.c")
+                subprocess.run([sys.executable, GEN_LAYOUT, "--routes", str(size),
+                                "--feedbacks", str(size * 2), "--switches", str(size),
+                                "--cstr", str(args.cstr), "--fbcstr", str(args.fbcstr),
+                                "--seed", str(args.layout_seed), "-o", layout], check=True, stdout=subprocess.DEVNULL)
+                rows.append((str(size), bench(args, [layout], hostbuild.layout_defines(layout), tmp)))
+
+    for i, (size, r) in enumerate(rows):
+        if i:
+            print()
+        report(r)
+
+    if args.csv:
+        common = {"date": datetime.datetime.now().isoformat(timespec="seconds"),
+                  "label": args.label if args.label is not None else git_label(),
+                  "delays": args.delays}
+        new = not os.path.exists(args.csv)
+        with open(args.csv, "a", newline="") as f:
+            w = csv.DictWriter(f, fieldnames=FIELDS)
+            if new:
+                w.writeheader()
+            for size, r in rows:
+                w.writerow(dict(common, size=size, **r))
+
+
+if __name__ == "__main__":
+    main()
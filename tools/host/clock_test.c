@@ -0,0 +1,80 @@
+/*
+ * clock_test.c
+ *
+ * Switch commands keep their timing when the RTC ticks between the
+ * mainloop time snapshot (ticks_now) and a Loconet tx done callback.
+ *
+ * Built with HOST_LOOPS_PER_TICK=1, so the RTC ticks after the snapshot
+ * in every mainloop pass (see host_run). Checks that each switch is on
+ * for SWITCH_ACTIVE_TIME, and that the next switch waits for the bus
+ * load gap after the off command.
+ *
+ * Created: 20-10-2026 09:41:18
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "bus_load.h"
+#include "host_env.h"
+#include "switch_queue.h"
+#include "ticks.h"
+
+#define SWITCH_ACTIVE_TIME  TICKS_FROM_MS(327)  // As switch_queue.c
+#define SWITCHES            10
+
+static ticks_t  on_time, off_time;
+static uint8_t  ons = 0, offs = 0;
+static uint8_t  errors = 0;
+
+
+static void sw_sent(uint16_t adr, bool dir, bool on)
+{
+    ticks_t         t = host_time();
+    ticks_t         gap = bus_load_gap();
+
+    if (on)
+    {
+        if (offs && t - off_time < HOST_LN_PACKET_TICKS + gap)
+        {
+            printf("FAIL: switch %u sent %lu ticks after previous off, gap is %lu\n", adr,
+                   (unsigned long)(t - off_time - HOST_LN_PACKET_TICKS), (unsigned long)gap);
+            errors++;
+        }
+        on_time = t;
+        ons++;
+    }
+    else
+    {
+        if (t - on_time < HOST_LN_PACKET_TICKS + SWITCH_ACTIVE_TIME)
+        {
+            printf("FAIL: switch %u on for %lu ticks, expected %lu\n", adr,
+                   (unsigned long)(t - on_time - HOST_LN_PACKET_TICKS), (unsigned long)SWITCH_ACTIVE_TIME);
+            errors++;
+        }
+        off_time = t;
+        offs++;
+    }
+}
+
+
+int main(void)
+{
+    uint16_t        i;
+
+    host_sw_hook = sw_sent;
+    host_init();
+
+    for (i = 0; i < SWITCHES; i++)
+        switch_queue_add(100 + i, i & 1);
+    host_run(TICKS_FROM_SEC(30));
+
+    if (ons != SWITCHES || offs != SWITCHES)
+    {
+        printf("FAIL: %u on and %u off commands sent, expected %u\n", ons, offs, SWITCHES);
+        errors++;
+    }
+    printf("%s: %u switches\n", errors ? "FAIL" : "OK", ons);
+    return errors ? 1 : 0;
+}
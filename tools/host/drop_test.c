@@ -0,0 +1,81 @@
+/*
+ * drop_test.c
+ *
+ * route_send_drop() drops queued commands for an address from the route
+ * queue and the switch queue, but not a switch request being sent.
+ *
+ * Created: 20-10-2026 11:02:36
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "host_env.h"
+#include "route.h"
+#include "switch_queue.h"
+#include "ticks.h"
+
+#define SENT_MAX 16
+
+static uint16_t sent[SENT_MAX];
+static uint8_t  nsent = 0;
+
+
+static void sw_sent(uint16_t adr, bool dir, bool on)
+{
+    if (on && nsent < SENT_MAX)
+        sent[nsent++] = adr;
+}
+
+static uint8_t check(const char *name, const uint16_t *expect, uint8_t n)
+{
+    uint8_t         i;
+
+    if (n == nsent && !memcmp(expect, sent, n * sizeof(uint16_t)))
+        return 0;
+
+    printf("FAIL: %s: sent", name);
+    for (i = 0; i < nsent; i++)
+        printf(" %u", sent[i]);
+    printf(", expected");
+    for (i = 0; i < n; i++)
+        printf(" %u", expect[i]);
+    printf("\n");
+    return 1;
+}
+
+
+int main(void)
+{
+    static const uint16_t swq_expect[] = { 10, 11, 12 };
+    static const uint16_t rq_expect[] = { 20, 22 };
+    uint8_t         errors = 0;
+
+    host_sw_hook = sw_sent;
+    host_init();
+
+    // Switch queue. 10 is being sent when dropped, the queued 10 is dropped
+    switch_queue_add(10, true);
+    switch_queue_add(11, true);
+    switch_queue_add(10, false);
+    switch_queue_add(12, true);
+    host_run(1);
+    route_send_drop(10);
+    host_run(TICKS_FROM_SEC(10));
+    errors += check("switch queue", swq_expect, sizeof(swq_expect) / sizeof(swq_expect[0]));
+
+    // Route queue
+    nsent = 0;
+    route_send_sw(20, true);
+    route_send_sw(21, true);
+    route_send_sw(22, true);
+    route_send_sw(21, false);
+    route_send_drop(21);
+    host_run(TICKS_FROM_SEC(10));
+    errors += check("route queue", rq_expect, sizeof(rq_expect) / sizeof(rq_expect[0]));
+
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * loop_layout.c
+ *
+ * Example layout for the digital twin (see loop.model) and the golden
+ * trace test (see loop.scenario).
+ *
+ * A loop of six blocks (feedback 1-6) with a siding (feedback 7)
+ * between block 3 and 4. Route n leaves block n+1 for the next block,
+ * route 6 goes from block 3 into the siding and route 7 from the siding
+ * into block 4. Routes 2 and 6 share the switch after block 3 (switch 200),
+ * routes 2 and 7 both enter block 4.
+ * Signals are switch addresses 100-107. A route is freed when the train
+ * enters the destination block.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fb_handler.h"
+#include "route.h"
+
+#define SIGNAL(num)     (100 + (num))
+#define SIDING_SWITCH   200
+
+#define ROUTE_SIGNAL(num) \
+static void act##num(void) \
+{ \
+    route_send_sw(SIGNAL(num), true); \
+} \
+static void free##num(void) \
+{ \
+    route_send_sw(SIGNAL(num), false); \
+}
+
+ROUTE_SIGNAL(0)
+ROUTE_SIGNAL(1)
+ROUTE_SIGNAL(3)
+ROUTE_SIGNAL(4)
+ROUTE_SIGNAL(5)
+ROUTE_SIGNAL(7)
+
+static void act2(void)
+{
+    route_send_sw(SIDING_SWITCH, true);
+    route_send_sw(SIGNAL(2), true);
+}
+
+static void free2(void)
+{
+    route_send_sw(SIGNAL(2), false);
+}
+
+static void act6(void)
+{
+    route_send_sw(SIDING_SWITCH, false);
+    route_send_sw(SIGNAL(6), true);
+}
+
+static void free6(void)
+{
+    route_send_sw(SIGNAL(6), false);
+}
+
+ROUTE(0, act0, free0, free0, CSTR_FB(2))
+ROUTE(1, act1, free1, free1, CSTR_FB(3))
+ROUTE(2, act2, free2, free2, CSTR_FB(4), CSTR_RT(6), CSTR_RT(7))
+ROUTE(3, act3, free3, free3, CSTR_FB(5))
+ROUTE(4, act4, free4, free4, CSTR_FB(6))
+ROUTE(5, act5, free5, free5, CSTR_FB(1))
+ROUTE(6, act6, free6, free6, CSTR_FB(7), CSTR_RT(2))
+ROUTE(7, act7, free7, free7, CSTR_FB(4), CSTR_RT(2))
+
+// Free the route when the train has entered the destination block
+static void arrived(uint16_t adr)
+{
+    switch (adr)
+    {
+    case 1:
+        route_free(5);
+        break;
+    case 2:
+        route_free(0);
+        break;
+    case 3:
+        route_free(1);
+        break;
+    case 4:
+        route_free(2);
+        route_free(7);
+        break;
+    case 5:
+        route_free(3);
+        break;
+    case 6:
+        route_free(4);
+        break;
+    case 7:
+        route_free(6);
+        break;
+    }
+}
+
+FEEDBACK_OCC(1, arrived)
+FEEDBACK_OCC(2, arrived)
+FEEDBACK_OCC(3, arrived)
+FEEDBACK_OCC(4, arrived)
+FEEDBACK_OCC(5, arrived)
+FEEDBACK_OCC(6, arrived)
+FEEDBACK_OCC(7, arrived)
@@ -0,0 +1,335 @@
+/*
+ * fuzz.c
+ *
+ * Randomised stress test of the route engine on the host.
+ *
+ * Runs a seeded random sequence of route_request/free/cancel/kill/
+ * forceactive calls, feedback and switch request noise from the bus,
+ * and time steps, and checks:
+ *  - A route only goes to AWAITEXE, or from AWAITCSTR to ACTIVE, when its
+ *    route constraints are not AWAITEXE/ACTIVE and its feedback
+ *    constraints are free.
+ *  - Two routes with constraints on each other are never AWAITEXE/ACTIVE
+ *    together (unless one was forced active).
+ *  - No lost commands: every route_send_sw/fb() call from the layout is
+ *    sent on the bus. A command dropped by a full queue is a violation too,
+ *    reported apart from commands lost without a trace.
+ *
+ * The same seed gives the same run. Prints one RESULT line with counters
+ * for fuzz.py to aggregate. Exit code is 1 if an invariant failed.
+ *
+ * Usage: fuzz <seed> <operations>
+ *
+ * Created: 19-10-2026 22:12:45
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "fb_handler.h"
+#include "host_env.h"
+#include "route.h"
+#include "switch_queue.h"
+#include "ticks.h"
+
+#define FUZZ_FB_MAX     512     // Feedback addresses used for noise
+#define FUZZ_REPORT_MAX 10      // Violations printed
+#define FUZZ_DRAIN      TICKS_FROM_SEC(120)
+
+extern const route_table_t __loconet_routetable_start;
+extern const route_table_t __loconet_routetable_end;
+extern const feedback_table_t __loconet_fbocctable_start;
+extern const feedback_table_t __loconet_fbocctable_end;
+extern const feedback_table_t __loconet_fbfreetable_start;
+extern const feedback_table_t __loconet_fbfreetable_end;
+
+// Layout calls are counted on the way in (linked with --wrap)
+extern void     __real_route_send_sw(uint16_t adr, bool opt);
+extern void     __real_route_send_sw_prio(uint16_t adr, bool opt);
+extern void     __real_route_send_fb(uint16_t adr, bool opt);
+extern void     __real_route_send_fb_prio(uint16_t adr, bool opt);
+
+static const route_table_t *entry[MAXROUTES];
+static routenum_t nums[MAXROUTES];
+static uint16_t nroutes = 0;
+static uint16_t fbs[FUZZ_FB_MAX];
+static uint16_t nfbs = 0;
+static bool     forced[MAXROUTES];
+static uint8_t  prev_state[MAXROUTES];  // State before the last change
+
+static uint64_t rnd_state;
+static uint64_t ops[6];
+static uint64_t transitions = 0;
+static uint64_t issued = 0;
+static uint64_t sent = 0;
+static uint64_t prio_failed = 0;
+static uint64_t violations = 0;
+static bool     forcing = false;
+
+
+static uint32_t rnd(uint32_t n)
+{
+    // xorshift64*
+    rnd_state ^= rnd_state >> 12;
+    rnd_state ^= rnd_state << 25;
+    rnd_state ^= rnd_state >> 27;
+    return (uint32_t)((rnd_state * 0x2545F4914F6CDD1DULL) >> 32) % n;
+}
+
+static void violation(const char *fmt, unsigned a, unsigned b)
+{
+    if (violations++ < FUZZ_REPORT_MAX)
+    {
+        printf("%10.3f VIOLATION: ", host_time() / (double)TICKS_PER_SEC);
+        printf(fmt, a, b);
+        printf("\n");
+    }
+}
+
+static bool busy(route_state_t st)
+{
+    return st == ROUTE_AWAITEXE || st == ROUTE_ACTIVE;
+}
+
+
+void __wrap_route_send_sw(uint16_t adr, bool opt)
+{
+    issued++;
+    __real_route_send_sw(adr, opt);
+}
+
+void __wrap_route_send_sw_prio(uint16_t adr, bool opt)
+{
+    issued++;
+    __real_route_send_sw_prio(adr, opt);
+}
+
+void __wrap_route_send_fb(uint16_t adr, bool opt)
+{
+    issued++;
+    __real_route_send_fb(adr, opt);
+}
+
+void __wrap_route_send_fb_prio(uint16_t adr, bool opt)
+{
+    uint64_t        before = sent;
+
+    issued++;
+    __real_route_send_fb_prio(adr, opt);
+    if (sent == before)
+        prio_failed++;
+}
+
+static void fb_sent(uint16_t adr, bool l)
+{
+    (void)adr;
+    (void)l;
+    sent++;
+}
+
+static void sw_sent(uint16_t adr, bool dir, bool on)
+{
+    (void)adr;
+    (void)dir;
+    if (on)
+        sent++;
+}
+
+static void route_changed(uint16_t num, uint8_t state)
+{
+    const route_table_t *p = entry[num];
+    uint8_t         prev = prev_state[num];
+    size_t          i;
+
+    transitions++;
+    prev_state[num] = state;
+    if (state == ROUTE_FREE)
+        forced[num] = false;
+    if (forcing && state == ROUTE_ACTIVE)
+        forced[num] = true;
+    if (!p)
+        return;
+
+    // Started at once (AWAITEXE), or activated when the constraints cleared (AWAITCSTR to ACTIVE).
+    // AWAITEXE to ACTIVE was checked on the way into AWAITEXE
+    if (state != ROUTE_AWAITEXE && (state != ROUTE_ACTIVE || prev != ROUTE_AWAITCSTR || forcing))
+        return;
+
+    for (i = 0; i < p->constraint_cnt; i++)
+    {
+        uint16_t        c = p->constraint[i];
+
+        if ((c & ROUTE_CSTR_TYPE_MASK) == ROUTE_CSTR_TYPE_RT)
+        {
+            if (c < MAXROUTES && c != num && busy(route_state(c)))
+                violation("route %u started while constraint route %u is busy", num, c);
+        }
+        else if (fb_handler_get_state(c & ROUTE_CSTR_DATA_MASK))
+        {
+            violation("route %u started while constraint feedback %u is occupied", num, c & ROUTE_CSTR_DATA_MASK);
+        }
+    }
+}
+
+static bool has_cstr(const route_table_t *p, routenum_t num)
+{
+    size_t          i;
+
+    for (i = 0; i < p->constraint_cnt; i++)
+        if (p->constraint[i] == num)
+            return true;
+    return false;
+}
+
+static void check_pairs(void)
+{
+    uint16_t        i;
+    size_t          j;
+
+    for (i = 0; i < nroutes; i++)
+    {
+        const route_table_t *p = entry[nums[i]];
+
+        if (!busy(route_state(p->routenum)) || forced[p->routenum])
+            continue;
+        for (j = 0; j < p->constraint_cnt; j++)
+        {
+            uint16_t        c = p->constraint[j];
+
+            if (c < MAXROUTES && c > p->routenum && entry[c] && busy(route_state(c)) && !forced[c]
+                && has_cstr(entry[c], p->routenum))
+                violation("conflicting routes %u and %u both busy", p->routenum, c);
+        }
+    }
+}
+
+
+static void setup(void)
+{
+    const route_table_t *p;
+    const feedback_table_t *f;
+    uint16_t        i;
+
+    for (p = &__loconet_routetable_start; p < &__loconet_routetable_end; p++)
+    {
+        if (p->routenum >= MAXROUTES || entry[p->routenum])
+            continue;
+        entry[p->routenum] = p;
+        nums[nroutes++] = p->routenum;
+        for (i = 0; i < p->constraint_cnt; i++)
+            if ((p->constraint[i] & ROUTE_CSTR_TYPE_MASK) == ROUTE_CSTR_TYPE_FB && nfbs < FUZZ_FB_MAX)
+                fbs[nfbs++] = p->constraint[i] & ROUTE_CSTR_DATA_MASK;
+    }
+
+    for (f = &__loconet_fbocctable_start; f < &__loconet_fbocctable_end && nfbs < FUZZ_FB_MAX; f++)
+        fbs[nfbs++] = f->adr;
+    for (f = &__loconet_fbfreetable_start; f < &__loconet_fbfreetable_end && nfbs < FUZZ_FB_MAX; f++)
+        fbs[nfbs++] = f->adr;
+    if (nfbs == 0)
+        fbs[nfbs++] = 1;
+}
+
+static void step(void)
+{
+    routenum_t      num = nums[rnd(nroutes)];
+    uint32_t        r = rnd(100);
+
+    if (r < 30)
+    {
+        ops[0]++;
+        route_request(num);
+    }
+    else if (r < 45)
+    {
+        ops[1]++;
+        route_free(num);
+    }
+    else if (r < 53)
+    {
+        ops[2]++;
+        route_cancel(num);
+    }
+    else if (r < 57)
+    {
+        ops[3]++;
+        route_kill(num);
+    }
+    else if (r < 58)
+    {
+        ops[4]++;
+        forcing = true;
+        route_forceactive(num);
+        forcing = false;
+    }
+    else if (r < 90)
+    {
+        ops[5]++;
+        host_rx_input_rep(fbs[rnd(nfbs)], rnd(2));
+    }
+    else
+    {
+        ops[5]++;
+        host_rx_sw_req(1 + rnd(64), rnd(2), true);
+    }
+
+    // Mostly short steps, sometimes long enough for delays and queues to run
+    host_run(rnd(20) == 0 ? 1 + rnd(TICKS_FROM_SEC(5)) : rnd(8));
+    check_pairs();
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned long long seed, n, i;
+    host_stat_t     st;
+    int64_t         lost;
+    unsigned        dropped;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <seed> <operations>\n", argv[0]);
+        return 2;
+    }
+    seed = strtoull(argv[1], NULL, 0);
+    n = strtoull(argv[2], NULL, 0);
+    rnd_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    host_fb_hook = fb_sent;
+    host_sw_hook = sw_sent;
+    host_route_hook = route_changed;
+    host_init();
+    setup();
+    if (nroutes == 0)
+    {
+        fprintf(stderr, "No routes in layout\n");
+        return 2;
+    }
+
+    for (i = 0; i < n; i++)
+        step();
+
+    // Let the queues empty before counting
+    host_run(FUZZ_DRAIN);
+    while (!switch_queue_empty())
+        host_run(TICKS_PER_SEC);
+    host_stat(&st);
+    dropped = st.rq_dropped + st.swq_dropped;
+    if (dropped)
+        violation("%u of %u commands dropped by full queues", dropped, (unsigned)issued);
+    lost = (int64_t)issued - (int64_t)(sent + prio_failed + dropped);
+    if (lost != 0)
+        violation("%u of %u commands lost", (unsigned)lost, (unsigned)issued);
+
+    printf("RESULT seed=%llu ops=%llu violations=%llu request=%llu free=%llu cancel=%llu kill=%llu force=%llu "
+           "noise=%llu transitions=%llu issued=%llu sent=%llu rq_peak=%u rq_dropped=%u swq_peak=%u "
+           "swq_dropped=%u tx_full=%u bus_busy_ticks=%u ticks=%u\n",
+           seed, n, (unsigned long long)violations, (unsigned long long)ops[0], (unsigned long long)ops[1],
+           (unsigned long long)ops[2], (unsigned long long)ops[3], (unsigned long long)ops[4],
+           (unsigned long long)ops[5], (unsigned long long)transitions, (unsigned long long)issued,
+           (unsigned long long)sent, st.rq_peak, st.rq_dropped, st.swq_peak, st.swq_dropped, st.tx_full,
+           st.busy, host_time());
+
+    return violations ? 1 : 0;
+}
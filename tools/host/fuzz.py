@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+fuzz.py
+
+Parallel stress and fuzz test of the route engine on the host.
+
+Builds fuzz.c with the route engine and a layout (see hostbuild.py), and
+runs many seeded instances at once, one process per instance, on all
+CPU cores. Each instance checks the invariants listed in fuzz.c
+(conflicting routes never active together, no lost or dropped
+commands). Counters from all instances are added up and reported with
+the run time.
+
+Without layout files a layout is generated with gen_layout.py.
+A failing seed is printed with the command to repeat it; the same seed
+and layout give the same run.
+
+Usage:
+  fuzz.py [layout.c ...] [--instances 64] [--ops 100000] [--seed 1] [--jobs 8]
+  fuzz.py --routes 200 --instances 256
+  fuzz.py layout.c --seed 1234 --instances 1 -v
+"""
+
+import argparse
+import concurrent.futures
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+
+import hostbuild
+
+GEN_LAYOUT = os.path.join(hostbuild.HOST_DIR, "..", "gen_layout.py")
+
+# Count layout calls of the send functions (see fuzz.c)
+WRAP = ["-Wl,--wrap=route_send_sw", "-Wl,--wrap=route_send_sw_prio",
+        "-Wl,--wrap=route_send_fb", "-Wl,--wrap=route_send_fb_prio"]
+
+# Counters added up over instances, the rest are maxima
+PEAKS = ("rq_peak", "swq_peak")
+
+
+def run(exe, seed, ops):
+    t0 = time.monotonic()
+    r = subprocess.run([exe, str(seed), str(ops)], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True)
+    wall = time.monotonic() - t0
+    result = None
+    for line in r.stdout.splitlines():
+        if line.startswith("RESULT "):
+            result = dict((k, int(v)) for k, v in (f.split("=") for f in line.split()[1:]))
+    return seed, r.returncode, result, r.stdout, wall
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("layout", nargs="*", help="Layout C files (default: generated)")
+    ap.add_argument("--instances", type=int, default=64, help="Number of instances (seeds)")
+    ap.add_argument("--ops", type=int, default=100000, help="Operations per instance")
+    ap.add_argument("--seed", type=int, default=1, help="First seed")
+    ap.add_argument("--jobs", type=int, default=os.cpu_count() or 1, help="Instances run at once")
+    ap.add_argument("--routes", type=int, default=50, help="Routes in the generated layout")
+    ap.add_argument("--layout-seed", type=int, default=1, help="Seed of the generated layout")
+    ap.add_argument("-D", dest="defines", action="append", default=[], help="Firmware define, e.g. MAXROUTES=400")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    ap.add_argument("-v", "--verbose", action="store_true", help="Print the output of each instance")
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        layout = [os.path.abspath(p) for p in args.layout]
+        if not layout:
+            layout = [os.path.join(tmp, "layout.c")]
+            subprocess.run([sys.executable, GEN_LAYOUT, "--routes", str(args.routes),
+                            "--feedbacks", str(args.routes * 2), "--switches", str(args.routes),
+                            "--seed", str(args.layout_seed), "-o", layout[0]], check=True, stdout=subprocess.DEVNULL)
+            if args.routes > 200 and not any(d.startswith("MAXROUTES=") for d in args.defines):
+                args.defines.append("MAXROUTES=%u" % args.routes)
+            # Pools large enough for the layout's delays, unless given
+            for k, v in sorted(hostbuild.layout_defines(layout[0]).items()):
+                if k.endswith("_POOL_SIZE") and not any(d.startswith(k + "=") for d in args.defines):
+                    args.defines.append("%s=%s" % (k, v))
+
+        exe = os.path.join(tmp, "fuzz")
+        # Fewer mainloop passes per tick than the twin; the invariants don't depend on it
+        hostbuild.build("fuzz.c", layout, exe, args.defines + ["HOST_LOOPS_PER_TICK=4"], args.cc, WRAP)
+
+        total = {}
+        failed = []
+        cpu = 0.0
+        t0 = time.monotonic()
+        seeds = range(args.seed, args.seed + args.instances)
+        with concurrent.futures.ThreadPoolExecutor(max_workers=max(args.jobs, 1)) as pool:
+            for seed, rc, result, out, wall in pool.map(lambda s: run(exe, s, args.ops), seeds):
+                cpu += wall
+                if args.verbose or rc != 0:
+                    sys.stdout.write(out)
+                if rc != 0 or result is None:
+                    failed.append((seed, rc))
+                    if result is None:
+                        continue
+                for k, v in result.items():
+                    if k == "seed":
+                        continue
+                    total[k] = max(total.get(k, 0), v) if k in PEAKS else total.get(k, 0) + v
+        wall = time.monotonic() - t0
+
+    done = args.instances - sum(1 for s, rc in failed if rc != 1)
+    print("Instances:    %u (seeds %u-%u), %u jobs" % (args.instances, seeds[0], seeds[-1], args.jobs))
+    if total:
+        print("Operations:   %u  (request %u, free %u, cancel %u, kill %u, force %u, noise %u)"
+              % (total["ops"], total["request"], total["free"], total["cancel"], total["kill"],
+                 total["force"], total["noise"]))
+        print("Transitions:  %u" % total["transitions"])
+        print("Commands:     %u issued, %u sent, %u dropped by full queues"
+              % (total["issued"], total["sent"], total["rq_dropped"] + total["swq_dropped"]))
+        print("Route queue:  peak %u, %u dropped" % (total["rq_peak"], total["rq_dropped"]))
+        print("Switch queue: peak %u, %u dropped" % (total["swq_peak"], total["swq_dropped"]))
+        print("Bus:          %.1f%% busy, %u tx FIFO full"
+              % (100.0 * total["bus_busy_ticks"] / max(total["ticks"], 1), total["tx_full"]))
+        print("Virtual time: %.1f h" % (total["ticks"] / 1024.0 / 3600))
+        print("Run time:     %.1f s, %.0f ops/s (%.0f ops/s per instance)"
+              % (wall, total["ops"] / wall, total["ops"] / max(cpu, 1e-9)))
+        print("Violations:   %u" % total["violations"])
+
+    if failed:
+        print()
+        print("Failed: %u of %u instances (%u completed)" % (len(failed), args.instances, done))
+        repro = ["fuzz.py"] + [shlex.quote(p) for p in args.layout] + ["-D" + d for d in args.defines]
+        if not args.layout:
+            repro += ["--routes", str(args.routes), "--layout-seed", str(args.layout_seed)]
+        for seed, rc in failed[:10]:
+            print("  seed %u exit %d: %s --seed %u --instances 1 -v" % (seed, rc, " ".join(repro), seed))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
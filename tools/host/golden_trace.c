@@ -0,0 +1,118 @@
+/*
+ * golden_trace.c
+ *
+ * Runs a golden trace scenario against the route engine (see
+ * golden_trace.py) and prints the packets received and sent, in the 'cap d'
+ * format, in ticks of virtual time from the start of the scenario.
+ *
+ * Scenario file, one event per line, time in ms from start:
+ *   0     fb 101 1       # OPC_INPUT_REP 101 occupied
+ *   500   sw 12 1        # OPC_SW_REQ 12 G
+ *   500   req 3          # route_request(3), as a dispatcher would
+ *   3000  end            # Run until 3000 ms
+ *
+ * Usage: golden_trace <scenario>
+ *
+ * Created: 20-10-2026 16:12:40
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_env.h"
+#include "route.h"
+#include "ticks.h"
+
+static void scenario_error(const char *path, int line, const char *msg)
+{
+    fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+    exit(2);
+}
+
+static void fb_sent(uint16_t adr, bool l)
+{
+    printf("%6lu TX FB %4u %u\n", (unsigned long)host_time(), adr, l);
+}
+
+static void sw_sent(uint16_t adr, bool dir, bool on)
+{
+    printf("%6lu TX SW %4u %u\n", (unsigned long)host_time(), adr, (dir ? 1 : 0) | (on ? 2 : 0));
+}
+
+
+int main(int argc, char *argv[])
+{
+    FILE           *f;
+    char            buf[256], *p;
+    char            kind[8];
+    unsigned long   ms;
+    unsigned        adr, val;
+    ticks_t         t;
+    int             line = 0, n;
+    bool            end = false;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: golden_trace <scenario>\n");
+        return 2;
+    }
+    f = fopen(argv[1], "r");
+    if (!f)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    host_fb_hook = fb_sent;
+    host_sw_hook = sw_sent;
+    host_init();
+
+    while (!end && fgets(buf, sizeof(buf), f))
+    {
+        line++;
+        if ((p = strchr(buf, '#')) != NULL)
+            *p = '\0';
+        n = sscanf(buf, "%lu %7s %u %u", &ms, kind, &adr, &val);
+        if (n <= 0)
+            continue;
+        if (n < 2)
+            scenario_error(argv[1], line, "Bad line");
+
+        // Events are in time order
+        t = TICKS_FROM_MS(ms);
+        if (t < host_time())
+            scenario_error(argv[1], line, "Time goes backwards");
+        host_run(t - host_time());
+
+        if (!strcmp(kind, "fb") && n == 4)
+        {
+            printf("%6lu RX FB %4u %u\n", (unsigned long)host_time(), adr, val != 0);
+            host_rx_input_rep(adr, val != 0);
+        }
+        else if (!strcmp(kind, "sw") && n == 4)
+        {
+            printf("%6lu RX SW %4u %u\n", (unsigned long)host_time(), adr, (val != 0) | 2);
+            host_rx_sw_req(adr, val != 0, true);
+        }
+        else if (!strcmp(kind, "req") && n == 3)
+        {
+            route_request(adr);
+        }
+        else if (!strcmp(kind, "end") && n == 2)
+        {
+            end = true;
+        }
+        else
+        {
+            scenario_error(argv[1], line, "Bad line");
+        }
+    }
+    fclose(f);
+
+    if (!end)
+        scenario_error(argv[1], line, "Missing end");
+    return 0;
+}
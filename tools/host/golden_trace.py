@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+golden_trace.py
+
+Golden trace regression test of the Loconet commands sent by routectrl3.
+
+Builds golden_trace.c with the route engine and the layout (see
+hostbuild.py) and runs a scenario in virtual time. The sent packets (TX)
+are compared with a stored golden trace: same packets in the same order,
+at the same tick. Timing is exact on the host, so any change of order or
+timing in route_queue/switch_queue, the tables or the layout shows up.
+See golden_trace.c for the scenario format.
+
+The golden trace has one record per line in the 'cap d' format, ticks
+from the start of the scenario. Record it with --record, check the diff
+and commit it with the scenario. A saved 'cap d' dump from the board can
+be compared too (--dump); its times are taken relative to the first
+record, and a --tolerance is needed as the board's bus timing differs.
+
+Usage:
+  golden_trace.py layout.c [more.c ...] scenario golden --record
+  golden_trace.py layout.c [more.c ...] scenario golden [--tolerance 0]
+  golden_trace.py --dump capture.txt golden --tolerance 50
+  golden_trace.py example/loop_layout.c example/loop.scenario example/loop.golden
+
+Exit code is 1 if the trace differs from the golden trace.
+"""
+
+import argparse
+import difflib
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import hostbuild
+
+REC_RE = re.compile(r"^\s*(\d+)\s+(RX|TX)\s+(FB|SW)\s+(\d+)\s+(\d+)\s*$")
+
+
+def parse_records(text, relative=False):
+    recs = [(int(m.group(1)), m.group(2), m.group(3), int(m.group(4)), int(m.group(5)))
+            for m in (REC_RE.match(line) for line in text.splitlines()) if m]
+    if recs and relative:
+        t0 = recs[0][0]
+        recs = [(r[0] - t0,) + r[1:] for r in recs]
+    return recs
+
+
+def format_rec(r):
+    return "%6u %s %s %4u %u" % r
+
+
+def run_scenario(layout, scenario, defines=(), cc=None):
+    """Run a scenario on the host engine. Returns the trace text."""
+    with tempfile.TemporaryDirectory() as tmp:
+        exe = os.path.join(tmp, "golden_trace")
+        hostbuild.build("golden_trace.c", [os.path.abspath(p) for p in layout], exe, defines, cc)
+        r = subprocess.run([exe, os.path.abspath(scenario)], stdout=subprocess.PIPE, universal_newlines=True)
+    if r.returncode != 0:
+        sys.exit("Scenario %s failed" % scenario)
+    return r.stdout
+
+
+def compare(recs, golden, tolerance):
+    """Print the differences. Returns True if the TX packets match."""
+    tx = [r for r in recs if r[1] == "TX"]
+    gtx = [r for r in golden if r[1] == "TX"]
+    ok = True
+
+    # Same packets in the same order
+    a = ["%s %s %u %u" % r[1:] for r in gtx]
+    b = ["%s %s %u %u" % r[1:] for r in tx]
+    if a != b:
+        ok = False
+        print("Packet order differs:")
+        for line in difflib.unified_diff(a, b, "golden", "trace", lineterm="", n=2):
+            print("  " + line)
+
+    # Timing
+    for g, r in zip(gtx, tx):
+        if g[1:] == r[1:] and abs(g[0] - r[0]) > tolerance:
+            ok = False
+            print("Timing: %s  (golden %u, now %u, %+d ticks)" % (format_rec(r)[7:], g[0], r[0], r[0] - g[0]))
+
+    return ok
+
+
+def check(layout, scenario, golden, tolerance=0, defines=(), cc=None):
+    """Run a scenario and compare with the golden trace. Returns True if it matches."""
+    recs = parse_records(run_scenario(layout, scenario, defines, cc))
+    with open(golden) as f:
+        return compare(recs, parse_records(f.read()), tolerance)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("files", nargs="+", help="Layout C files, scenario and golden trace (golden only with --dump)")
+    ap.add_argument("--dump", help="Compare a saved 'cap d' dump instead of running a scenario")
+    ap.add_argument("--record", action="store_true", help="Write the golden trace instead of comparing")
+    ap.add_argument("--tolerance", type=int, default=0, help="Allowed timing difference in ticks")
+    ap.add_argument("-D", dest="defines", action="append", default=[], help="Firmware define, e.g. MAXROUTES=400")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    args = ap.parse_args()
+
+    golden = args.files[-1]
+    if args.dump:
+        if len(args.files) != 1:
+            ap.error("Give only the golden trace with --dump")
+        with open(args.dump) as f:
+            recs = parse_records(f.read(), relative=True)
+    elif len(args.files) >= 3:
+        recs = parse_records(run_scenario(args.files[:-2], args.files[-2], args.defines, args.cc))
+    else:
+        ap.error("Give layout files, scenario and golden trace, or --dump")
+
+    if not recs:
+        sys.exit("No records")
+
+    if args.record:
+        with open(golden, "w") as f:
+            for r in recs:
+                f.write(format_rec(r) + "\n")
+        print("Recorded %u records (%u TX)" % (len(recs), sum(1 for r in recs if r[1] == "TX")))
+        return
+
+    with open(golden) as f:
+        ok = compare(recs, parse_records(f.read()), args.tolerance)
+    if ok:
+        print("OK: %u TX packets match" % sum(1 for r in recs if r[1] == "TX"))
+    else:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
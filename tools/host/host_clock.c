@@ -0,0 +1,20 @@
+/*
+ * host_clock.c
+ *
+ * Host monotonic clock for benchmarks. In a file of its own as <time.h>
+ * declares timer_delete() and timer_t like the firmware's timer.h.
+ *
+ * Created: 20-10-2026 13:41:07
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t host_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
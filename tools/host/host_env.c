@@ -0,0 +1,317 @@
+/*
+ * host_env.c
+ *
+ * Host build environment of the route engine.
+ * Virtual time, Loconet bus model and stubs of the firmware modules
+ * that are not part of the host build.
+ *
+ * Created: 19-10-2026 21:04:37
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "bus_load.h"
+#include "capture.h"
+#include "host_env.h"
+#include "local_fb.h"
+#include "local_out.h"
+#include "perf.h"
+#include "reflex.h"
+#include "route.h"
+#include "route_queue.h"
+#include "statestream.h"
+#include "sw_handler.h"
+#include "switch_queue.h"
+#include "term.h"
+#include "ticks.h"
+#include "timer.h"
+#include "trace.h"
+#include "lib/loconet-avrda/ln_rx.h"
+#include "lib/loconet-avrda/ln_tx.h"
+
+#define LN_TX_FIFO      16      // As LNPACKET_CNT in the firmware build
+
+typedef struct
+{
+    ticks_t         done;
+    hal_ln_tx_done_cb *cb;
+    void           *ctx;
+} ln_tx_t;
+
+void            (*host_fb_hook)(uint16_t adr, bool l);
+void            (*host_sw_hook)(uint16_t adr, bool dir, bool on);
+void            (*host_route_hook)(uint16_t num, uint8_t state);
+
+static ticks_t  now = 0;        // The RTC
+static ticks_t  snapshot = 0;   // ticks_now()
+static ticks_t  bus_free = 0;
+static ln_tx_t  tx_fifo[LN_TX_FIFO];
+static uint8_t  tx_ridx = 0;
+static uint8_t  tx_cnt = 0;
+static host_stat_t stat;
+
+
+// Virtual time
+
+void ticks_init(void)
+{
+}
+
+void ticks_update(void)
+{
+    snapshot = now;
+}
+
+ticks_t ticks_get(void)
+{
+    return now;
+}
+
+ticks_t ticks_elapsed(ticks_t t0)
+{
+    return now - t0;
+}
+
+ticks_t ticks_now(void)
+{
+    return snapshot;
+}
+
+ticks_t ticks_now_elapsed(ticks_t t0)
+{
+    return snapshot - t0;
+}
+
+hrticks_t ticks_hr_get(void)
+{
+    return now * (F_CPU / TICKS_PER_SEC);
+}
+
+hrticks_t ticks_hr_elapsed(hrticks_t t0)
+{
+    return ticks_hr_get() - t0;
+}
+
+
+// Loconet bus. One packet at a time, in the order sent or received
+
+static ticks_t bus_take(void)
+{
+    if (bus_free < now)
+        bus_free = now;
+    bus_free += HOST_LN_PACKET_TICKS;
+    stat.busy += HOST_LN_PACKET_TICKS;
+    return bus_free;
+}
+
+static int8_t tx_put(hal_ln_tx_done_cb * cb, void *ctx)
+{
+    ln_tx_t        *t;
+
+    if (tx_cnt >= LN_TX_FIFO)
+    {
+        stat.tx_full++;
+        return -1;
+    }
+    t = &tx_fifo[(tx_ridx + tx_cnt) % LN_TX_FIFO];
+    t->done = bus_take();
+    t->cb = cb;
+    t->ctx = ctx;
+    tx_cnt++;
+    return 0;
+}
+
+static void tx_update(void)
+{
+    while (tx_cnt && (int32_t)(now - tx_fifo[tx_ridx].done) >= 0)
+    {
+        ln_tx_t         t = tx_fifo[tx_ridx];
+
+        tx_ridx = (tx_ridx + 1) % LN_TX_FIFO;
+        tx_cnt--;
+        if (t.cb)
+            t.cb(t.ctx, HAL_LN_SUCCESS);
+    }
+}
+
+int8_t ln_tx_opc_input_rep(uint16_t adr, bool l, hal_ln_tx_done_cb * cb, void *ctx)
+{
+    if (tx_put(cb, ctx) != 0)
+        return -1;
+    stat.tx_fb++;
+    if (host_fb_hook)
+        host_fb_hook(adr, l);
+    return 0;
+}
+
+int8_t ln_tx_opc_sw_req(uint16_t adr, bool dir, bool on, hal_ln_tx_done_cb * cb, void *ctx)
+{
+    if (tx_put(cb, ctx) != 0)
+        return -1;
+    stat.tx_sw++;
+    if (host_sw_hook)
+        host_sw_hook(adr, dir, on);
+    return 0;
+}
+
+void host_rx_input_rep(uint16_t adr, bool l)
+{
+    bus_take();
+    stat.rx++;
+    ln_rx_opc_input_rep(adr, l, 1);
+}
+
+void host_rx_sw_req(uint16_t adr, bool dir, bool on)
+{
+    bus_take();
+    stat.rx++;
+    ln_rx_opc_sw_req(adr, dir, on);
+}
+
+
+// Engine
+
+void host_init(void)
+{
+    timer_init();
+    route_init();
+}
+
+void host_run(ticks_t t)
+{
+    uint8_t         i, peak;
+
+    while (t--)
+    {
+        for (i = 0; i < HOST_LOOPS_PER_TICK; i++)
+        {
+            ticks_update();
+            // The RTC ticks during the last pass, after the snapshot, as it can on the board
+            if (i == HOST_LOOPS_PER_TICK - 1)
+                now++;
+            tx_update();
+            timer_update();
+            bus_load_update();
+            switch_queue_update();
+            sw_handler_update();
+            route_update();
+        }
+
+        if (!switch_queue_empty())
+            stat.swq_busy++;
+        stat.rq_dropped += route_send_stat(&peak);
+        if (peak > stat.rq_peak)
+            stat.rq_peak = peak;
+        stat.swq_dropped += switch_queue_stat(&peak);
+        if (peak > stat.swq_peak)
+            stat.swq_peak = peak;
+    }
+}
+
+ticks_t host_time(void)
+{
+    return now;
+}
+
+void host_stat(host_stat_t *st)
+{
+    *st = stat;
+}
+
+int host_printf_P(const char *fmt, ...)
+{
+    char            buf[256];
+    char           *p;
+    va_list         ap;
+    int             n;
+
+    // %S is a string in flash on the AVR
+    strncpy(buf, fmt, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (p = buf; (p = strstr(p, "%S")) != NULL; p += 2)
+        p[1] = 's';
+
+    va_start(ap, fmt);
+    n = vprintf(buf, ap);
+    va_end(ap);
+    return n;
+}
+
+
+// Stubs of firmware modules not in the host build
+
+uint8_t         trace_level[TRACE_MOD_CNT];
+
+void trace_put(uint8_t ev, uint16_t a, uint16_t b)
+{
+    (void)ev;
+    (void)a;
+    (void)b;
+}
+
+void capture_put(capture_type_t type, uint16_t adr, uint8_t val)
+{
+    (void)type;
+    (void)adr;
+    (void)val;
+}
+
+void statestream_route(uint16_t num, uint8_t state)
+{
+    if (host_route_hook)
+        host_route_hook(num, state);
+}
+
+void statestream_fb(uint16_t adr, bool occ)
+{
+    (void)adr;
+    (void)occ;
+}
+
+void statestream_sw(uint16_t adr, bool dir)
+{
+    (void)adr;
+    (void)dir;
+}
+
+bool local_fb_is_local(uint16_t adr)
+{
+    (void)adr;
+    return false;
+}
+
+bool local_out_set(uint16_t adr, bool dir)
+{
+    (void)adr;
+    (void)dir;
+    return false;
+}
+
+bool local_out_is_local(uint16_t adr)
+{
+    (void)adr;
+    return false;
+}
+
+void reflex_input(uint16_t adr, bool l)
+{
+    (void)adr;
+    (void)l;
+}
+
+void perf_record(perf_id_t id, hrticks_t cycles)
+{
+    (void)id;
+    (void)cycles;
+}
+
+void term_continue(term_cont_cb * cb)
+{
+    while (cb())
+        ;
+}
@@ -0,0 +1,111 @@
+/*
+ * host_env.h
+ *
+ * Host build environment of the route engine.
+ *
+ * Runs the real route.c, route_queue.c, switch_queue.c, route_delay.c,
+ * timer.c, fb_handler.c, sw_handler.c, bus_load.c and latency.c on the
+ * host, with virtual time and a model of the Loconet bus. The rest of the
+ * firmware is stubbed.
+ * Each process holds one engine instance (the firmware uses static state).
+ *
+ * Created: 19-10-2026 21:04:12
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+
+#ifndef HOST_ENV_H_
+#define HOST_ENV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ticks.h"
+
+#ifndef HOST_LOOPS_PER_TICK
+#define HOST_LOOPS_PER_TICK 32  // Mainloop passes per tick of virtual time
+#endif
+
+#ifndef HOST_LN_PACKET_TICKS
+#define HOST_LN_PACKET_TICKS 4  // Bus time of a 4 byte Loconet packet incl. CD backoff
+#endif
+
+typedef struct
+{
+    uint32_t        tx_fb;      // OPC_INPUT_REP sent
+    uint32_t        tx_sw;      // OPC_SW_REQ sent
+    uint32_t        rx;         // Packets received
+    uint32_t        tx_full;    // Sends refused because the tx FIFO was full
+    ticks_t         busy;       // Ticks the bus was in use
+    uint8_t         rq_peak;    // Route send queue peak
+    uint8_t         swq_peak;   // Switch queue peak
+    uint32_t        rq_dropped; // Route send queue drops
+    uint32_t        swq_dropped;        // Switch queue drops
+    ticks_t         swq_busy;   // Ticks the switch queue was not empty
+} host_stat_t;
+
+/**
+ * Called when the firmware has sent OPC_INPUT_REP.
+ */
+extern void     (*host_fb_hook)(uint16_t adr, bool l);
+
+/**
+ * Called when the firmware has sent OPC_SW_REQ.
+ */
+extern void     (*host_sw_hook)(uint16_t adr, bool dir, bool on);
+
+/**
+ * Called when a route changes state, after the state is set.
+ */
+extern void     (*host_route_hook)(uint16_t num, uint8_t state);
+
+/**
+ * Initialize the engine. Call once.
+ */
+extern void     host_init(void);
+
+/**
+ * Run the firmware mainloop.
+ *
+ * @param t Ticks of virtual time to run.
+ */
+extern void     host_run(ticks_t t);
+
+/**
+ * Get virtual time.
+ *
+ * @return Ticks since host_init().
+ */
+extern ticks_t  host_time(void);
+
+/**
+ * Receive OPC_INPUT_REP from the bus.
+ *
+ * @param adr Feedback address.
+ * @param l   True if occupied.
+ */
+extern void     host_rx_input_rep(uint16_t adr, bool l);
+
+/**
+ * Receive OPC_SW_REQ from the bus.
+ *
+ * @param adr Switch address.
+ * @param dir Direction. True is closed/green.
+ * @param on  Output on.
+ */
+extern void     host_rx_sw_req(uint16_t adr, bool dir, bool on);
+
+/**
+ * Get statistics since host_init().
+ *
+ * @param st Returns statistics.
+ */
+extern void     host_stat(host_stat_t *st);
+
+/**
+ * Get host time, for benchmarks. Not virtual time.
+ *
+ * @return Nanoseconds of a monotonic clock.
+ */
+extern uint64_t host_clock_ns(void);
+
+#endif /* HOST_ENV_H_ */
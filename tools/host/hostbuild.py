@@ -0,0 +1,69 @@
+"""
+hostbuild.py
+
+Build the route engine for the host (see host_env.h), with a layout
+and a harness main (twin.c, fuzz.c, bench.c, replay.c, golden_trace.c,
+the *_test.c run by hosttest.py).
+
+The real firmware sources are compiled with the headers in shim/ in
+place of the AVR and library headers, and linked with a copy of
+routetables.ld so the Loconet tables are laid out as on the board.
+Note: if the lib/ submodules are checked out, the firmware's
+#include "lib/..." finds the real library headers before the shims.
+"""
+
+import os
+import platform
+import re
+import subprocess
+import sys
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+FIRMWARE_DIR = os.path.join(HOST_DIR, "..", "..", "routectrl3")
+
+ENGINE = ["route.c", "route_queue.c", "switch_queue.c", "route_delay.c", "timer.c",
+          "fb_handler.c", "sw_handler.c", "bus_load.c", "latency.c"]
+
+# Firmware defaults (route_delay.h, timer.h)
+ROUTE_DELAY_POOL_SIZE = 64
+TIMER_POOL_SIZE = 80
+
+
+def layout_defines(path):
+    """The defines listed under 'Build with:' in a generated layout."""
+    with open(path) as f:
+        head = f.read(2048)
+    return dict(re.findall(r"\b([A-Z_]+)=(\d+)", head.split("*/")[0]))
+
+
+def linker_script(path):
+    """routetables.ld, with each table aligned for host pointers, placed with the read-only data."""
+    with open(os.path.join(FIRMWARE_DIR, "routetables.ld")) as f:
+        text = f.read()
+    text = text.replace("    PROVIDE (__loconet_", "    . = ALIGN(8);\n    PROVIDE (__loconet_")
+    text = text.replace("INSERT AFTER .text", "INSERT AFTER .rodata")
+    with open(path, "w") as f:
+        f.write(text)
+
+
+def build(main, layout, out, defines=(), cc=None, ldflags=()):
+    """Compile and link. Exits on errors."""
+    cc = cc or os.environ.get("CC", "cc")
+    ld = out + ".ld"
+    linker_script(ld)
+
+    cmd = [cc, "-std=gnu11", "-O2", "-g", "-no-pie", "-Wall", "-Wno-unused-parameter",
+           "-include", os.path.join(HOST_DIR, "shim", "host_pre.h"),
+           "-I", os.path.join(HOST_DIR, "shim"), "-I", HOST_DIR, "-I", FIRMWARE_DIR]
+    if platform.machine() in ("x86_64", "AMD64", "i686"):
+        # Don't pad table entries beyond the ABI alignment
+        cmd.append("-malign-data=abi")
+    cmd += ["-D" + d for d in defines]
+    cmd += [os.path.join(FIRMWARE_DIR, f) for f in ENGINE]
+    cmd += [os.path.join(HOST_DIR, "host_env.c"), os.path.join(HOST_DIR, "host_clock.c"), os.path.join(HOST_DIR, main)]
+    cmd += list(layout)
+    cmd += ["-Wl,-T," + ld] + list(ldflags) + ["-o", out]
+
+    r = subprocess.run(cmd)
+    if r.returncode != 0:
+        sys.exit("Host build failed")
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+hosttest.py
+
+Run the host build tests of the route engine.
+
+Each test is a harness main in this directory, built with the route
+engine (see hostbuild.py), optionally a layout, and its own defines.
+A test passes when it exits with 0.
+Golden trace tests run a scenario with golden_trace.py and pass when the
+sent packets match the committed golden trace.
+
+Usage:
+  hosttest.py [test ...] [--cc clang] [-v]
+  hosttest.py clock_test
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+import golden_trace
+import hostbuild
+
+# name: (layout files, defines)
+TESTS = {
+    "clock_test": ([], ["HOST_LOOPS_PER_TICK=1"]),
+    "drop_test": ([], []),
+}
+
+# name: (layout files, scenario, golden trace)
+GOLDEN = {
+    "loop_golden": (["example/loop_layout.c"], "example/loop.scenario", "example/loop.golden"),
+}
+
+
+def host_path(f):
+    if isinstance(f, list):
+        return [host_path(p) for p in f]
+    return os.path.join(hostbuild.HOST_DIR, f)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("tests", nargs="*", help="Tests to run (default all)")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    ap.add_argument("-v", "--verbose", action="store_true", help="Print the output of passed tests too")
+    args = ap.parse_args()
+
+    names = args.tests or sorted(TESTS) + sorted(GOLDEN)
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        for name in names:
+            if name in GOLDEN:
+                layout, scenario, golden = [host_path(f) for f in GOLDEN[name]]
+                ok = golden_trace.check(layout, scenario, golden, cc=args.cc)
+                print("%-20s %s" % (name, "ok" if ok else "FAILED"))
+                if not ok:
+                    failed.append(name)
+                continue
+            if name not in TESTS:
+                sys.exit("Unknown test %s" % name)
+            layout, defines = TESTS[name]
+            exe = os.path.join(tmp, name)
+            hostbuild.build(name + ".c", [os.path.join(hostbuild.HOST_DIR, f) for f in layout], exe, defines, args.cc)
+            r = subprocess.run([exe], cwd=hostbuild.HOST_DIR, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                               universal_newlines=True)
+            if r.returncode != 0 or args.verbose:
+                sys.stdout.write(r.stdout)
+            print("%-20s %s" % (name, "ok" if r.returncode == 0 else "FAILED"))
+            if r.returncode != 0:
+                failed.append(name)
+
+    if failed:
+        sys.exit("%u of %u tests failed" % (len(failed), len(names)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+/*
+ * replay.c
+ *
+ * Replay of a Loconet capture ('cap d' dump) into the route engine.
+ *
+ * The received packets of the dump are fed into the Loconet RX handlers at
+ * their captured time (virtual time), or one tick apart with 'fast'. The
+ * packets the engine sends are printed in the dump format, in the time of
+ * the dump, so they can be compared with the captured TX records. Lines
+ * that aren't records (shell prompt, command echo) are skipped.
+ *
+ * Usage: replay <dump> [fast]
+ *
+ * Created: 20-10-2026 15:04:22
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_env.h"
+#include "ticks.h"
+
+#define REPLAY_TAIL_SEC 10      // Run after the last record, for queues to drain
+
+typedef struct
+{
+    ticks_t         t;
+    bool            rx;
+    bool            fb;
+    uint16_t        adr;
+    uint8_t         val;
+} replay_rec_t;
+
+static replay_rec_t *recs = NULL;
+static uint32_t nrecs = 0;
+static ticks_t  t0;             // Time of first record
+static uint32_t ntx = 0;
+
+
+static void read_dump(const char *path)
+{
+    FILE           *f = fopen(path, "r");
+    char            buf[256], dir[4], type[4];
+    unsigned long   t;
+    unsigned        adr, val;
+    uint32_t        size = 0;
+
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    while (fgets(buf, sizeof(buf), f))
+    {
+        if (sscanf(buf, "%lu %3s %3s %u %u", &t, dir, type, &adr, &val) != 5)
+            continue;
+        if ((strcmp(dir, "RX") && strcmp(dir, "TX")) || (strcmp(type, "FB") && strcmp(type, "SW")))
+            continue;
+        if (nrecs == size)
+        {
+            size = size ? size * 2 : 256;
+            recs = realloc(recs, size * sizeof(replay_rec_t));
+            if (!recs)
+            {
+                perror("realloc");
+                exit(2);
+            }
+        }
+        recs[nrecs].t = t;
+        recs[nrecs].rx = dir[0] == 'R';
+        recs[nrecs].fb = type[0] == 'F';
+        recs[nrecs].adr = adr;
+        recs[nrecs].val = val;
+        nrecs++;
+    }
+    fclose(f);
+}
+
+static void fb_sent(uint16_t adr, bool l)
+{
+    ntx++;
+    printf("%10lu TX FB %4u %u\n", (unsigned long)(t0 + host_time()), adr, l);
+}
+
+static void sw_sent(uint16_t adr, bool dir, bool on)
+{
+    ntx++;
+    printf("%10lu TX SW %4u %u\n", (unsigned long)(t0 + host_time()), adr, (dir ? 1 : 0) | (on ? 2 : 0));
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool            fast = argc > 2 && !strcmp(argv[2], "fast");
+    uint32_t        i, nrx = 0;
+    ticks_t         t;
+    uint64_t        ns;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: replay <dump> [fast]\n");
+        return 2;
+    }
+    read_dump(argv[1]);
+    if (nrecs == 0)
+    {
+        fprintf(stderr, "%s: No capture records\n", argv[1]);
+        return 2;
+    }
+
+    host_fb_hook = fb_sent;
+    host_sw_hook = sw_sent;
+    host_init();
+    t0 = recs[0].t;
+
+    ns = host_clock_ns();
+    for (i = 0; i < nrecs; i++)
+    {
+        if (!recs[i].rx)
+            continue;
+        if (fast)
+        {
+            host_run(1);
+        }
+        else
+        {
+            t = recs[i].t - t0;
+            if ((int32_t)(t - host_time()) > 0)
+                host_run(t - host_time());
+        }
+        nrx++;
+        if (recs[i].fb)
+            host_rx_input_rep(recs[i].adr, recs[i].val != 0);
+        else
+            host_rx_sw_req(recs[i].adr, recs[i].val & 1, (recs[i].val >> 1) & 1);
+    }
+    host_run(TICKS_FROM_SEC(REPLAY_TAIL_SEC));
+    ns = host_clock_ns() - ns;
+
+    printf("RESULT records=%u rx=%u tx_captured=%u tx=%u ticks=%lu host_us=%lu\n",
+           nrecs, nrx, nrecs - nrx, ntx, (unsigned long)host_time(), (unsigned long)(ns / 1000));
+    return 0;
+}
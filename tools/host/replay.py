@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""
+replay.py
+
+Replay a Loconet capture into the route engine on the host.
+
+Capture on the board with 'cap on', and save the output of 'cap d' to a
+file when something has gone wrong. replay.py builds replay.c with the
+route engine and the layout (see hostbuild.py) and feeds the received
+packets of the dump into it, at the captured time (virtual time, so the
+run takes no longer than the host needs) or one tick apart with --fast.
+Nothing is sent to the layout.
+
+The packets the engine sent are compared with the captured TX records,
+if any, address and value in order. On a difference the first
+differences are shown and the exit status is 1. With -v the engine's
+packets are printed in the dump format.
+
+Usage:
+  replay.py layout.c [more.c ...] dump.txt [--fast] [-v] [-D MAXROUTES=400]
+"""
+
+import argparse
+import difflib
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import hostbuild
+
+RECORD = re.compile(r"^\s*(\d+)\s+(RX|TX)\s+(FB|SW)\s+(\d+)\s+(\d+)\s*$")
+
+
+def tx_records(lines):
+    """TX records as 'FB adr val', without time."""
+    out = []
+    for line in lines:
+        m = RECORD.match(line)
+        if m and m.group(2) == "TX":
+            out.append("%s %s %s" % (m.group(3), m.group(4), m.group(5)))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("layout", nargs="+", help="Layout C files")
+    ap.add_argument("dump", help="Output of 'cap d'")
+    ap.add_argument("--fast", action="store_true", help="Feed the packets one tick apart")
+    ap.add_argument("-D", dest="defines", action="append", default=[], help="Firmware define, e.g. MAXROUTES=400")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    ap.add_argument("-v", "--verbose", action="store_true", help="Print the packets sent by the engine")
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        exe = os.path.join(tmp, "replay")
+        hostbuild.build("replay.c", [os.path.abspath(p) for p in args.layout], exe, args.defines, args.cc)
+        r = subprocess.run([exe, os.path.abspath(args.dump)] + (["fast"] if args.fast else []),
+                           stdout=subprocess.PIPE, universal_newlines=True)
+    if r.returncode != 0:
+        sys.stdout.write(r.stdout)
+        sys.exit(r.returncode)
+
+    lines = r.stdout.splitlines()
+    result = {}
+    for line in lines:
+        if line.startswith("RESULT "):
+            result = dict(f.split("=") for f in line.split()[1:])
+        elif args.verbose:
+            print(line)
+
+    with open(args.dump) as f:
+        captured = tx_records(f)
+    sent = tx_records(lines)
+    print("Replayed:  %s RX packets in %.1f s virtual time, %.1f ms host time"
+          % (result["rx"], int(result["ticks"]) / 1024.0, int(result["host_us"]) / 1000.0))
+    print("Sent:      %u packets, %u captured" % (len(sent), len(captured)))
+    if not captured:
+        return
+    if sent == captured:
+        print("TX matches the capture")
+        return
+    # The capture may start or end in the middle of a sequence; show where it differs
+    diff = list(difflib.unified_diff(captured, sent, "captured", "replayed", n=2, lineterm=""))
+    for line in diff[:40]:
+        print(line)
+    if len(diff) > 40:
+        print("... %u more diff lines" % (len(diff) - 40))
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
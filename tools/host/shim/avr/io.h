@@ -0,0 +1,25 @@
+/*
+ * Host build shim of <avr/io.h>.
+ * Only the types used in firmware headers. Peripheral access is not supported.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    volatile uint8_t DIR, DIRSET, DIRCLR, DIRTGL;
+    volatile uint8_t OUT, OUTSET, OUTCLR, OUTTGL;
+    volatile uint8_t IN, INTFLAGS, PORTCTRL, PINCONFIG;
+    volatile uint8_t PINCTRLUPD, PINCTRLSET, PINCTRLCLR, reserved;
+    volatile uint8_t PINCTRL[8];
+} PORT_t;
+
+typedef struct
+{
+    volatile uint8_t DIR, OUT, IN, INTFLAGS;
+} VPORT_t;
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,25 @@
+/*
+ * Host build shim of <avr/pgmspace.h>.
+ * Flash and RAM are the same address space on the host.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_word(p)    (*(const uint16_t *)(p))
+#define strcmp_P            strcmp
+#define strncmp_P           strncmp
+#define snprintf_P          snprintf
+
+// %S (string in flash) is %s on the host
+extern int      host_printf_P(const char *fmt, ...);
+#define printf_P            host_printf_P
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,22 @@
+/*
+ * Included first in every file of the host build (-include).
+ * AVR compiler extensions used by the firmware, as plain C.
+ */
+
+#ifndef HOST_PRE_H_
+#define HOST_PRE_H_
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 24000000UL
+#endif
+
+#define __flash
+#define __flashx
+#define __memx
+
+#define __builtin_avr_mask1(a, b) ((uint8_t)((a) << (b)))
+#define __builtin_avr_delay_cycles(x) ((void)0)
+
+#endif /* HOST_PRE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Host build shim of avr-shell-cmd.
+ * Shell commands are compiled, but not registered.
+ */
+
+#ifndef HOST_CMD_H_
+#define HOST_CMD_H_
+
+#include <stdint.h>
+
+#define CMD(name, desc) \
+    static void (*const name##_host_cmd)(uint8_t argc, char *argv[]) __attribute__((unused)) = name##Cmd
+
+#endif /* HOST_CMD_H_ */
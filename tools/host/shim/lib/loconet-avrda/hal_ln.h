@@ -0,0 +1,19 @@
+/*
+ * Host build shim of the loconet-avrda HAL.
+ */
+
+#ifndef HOST_HAL_LN_H_
+#define HOST_HAL_LN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    HAL_LN_SUCCESS,
+    HAL_LN_FAIL
+} hal_ln_result_t;
+
+typedef void    (hal_ln_tx_done_cb)(void *ctx, hal_ln_result_t res);
+
+#endif /* HOST_HAL_LN_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Host build shim of loconet-avrda ln_rx.
+ * The firmware implements the callbacks. host_env.c calls them.
+ */
+
+#ifndef HOST_LN_RX_H_
+#define HOST_LN_RX_H_
+
+#include <stdint.h>
+
+extern void     ln_rx_opc_input_rep(uint16_t adr, uint8_t l, uint8_t x);
+extern void     ln_rx_opc_sw_req(uint16_t adr, uint8_t dir, uint8_t on);
+
+#endif /* HOST_LN_RX_H_ */
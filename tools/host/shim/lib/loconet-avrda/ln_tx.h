@@ -0,0 +1,16 @@
+/*
+ * Host build shim of loconet-avrda ln_tx.
+ * Implemented by host_env.c, which models the Loconet bus.
+ */
+
+#ifndef HOST_LN_TX_H_
+#define HOST_LN_TX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal_ln.h"
+
+extern int8_t   ln_tx_opc_input_rep(uint16_t adr, bool l, hal_ln_tx_done_cb * cb, void *ctx);
+extern int8_t   ln_tx_opc_sw_req(uint16_t adr, bool dir, bool on, hal_ln_tx_done_cb * cb, void *ctx);
+
+#endif /* HOST_LN_TX_H_ */
@@ -0,0 +1,426 @@
+/*
+ * twin.c
+ *
+ * Digital twin. Simulated trains drive the real route engine.
+ *
+ * Trains move through feedback sections, wait for the route signal
+ * (a switch address set by route_send_sw()) before entering a route, and
+ * send OPC_INPUT_REP occupied/free as they go. The layout's FEEDBACK_OCC/
+ * FREE() and ROUTE() callbacks run as on the board. Time is virtual.
+ *
+ * Model file, one item per line, times in seconds:
+ *   clear <s>                      Time to clear a section after entering the next (default 2)
+ *   route <num> signal <swadr> path <fb>:<s> [<fb>:<s> ...] [free]
+ *                                  Sections entered in order, with the time spent in each.
+ *                                  'free' calls route_free() when the train reaches the last
+ *                                  section, for layouts that don't free the route themselves.
+ *   train <name> <start s> at <fb> [dwell <s>] routes <num> [<num> ...] [repeat]
+ *                                  The dispatcher requests each route (route_request())
+ *                                  when the train is ready to leave.
+ *
+ * Usage: twin <model> [hours]
+ *
+ * Created: 19-10-2026 21:31:08
+ *  Author: Mikael Ejberg Pedersen
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fb_handler.h"
+#include "host_env.h"
+#include "route.h"
+#include "sw_handler.h"
+#include "ticks.h"
+
+#define TWIN_ROUTES_MAX 4096
+#define TWIN_TRAINS_MAX 64
+#define TWIN_PATH_MAX   16
+#define TWIN_LEGS_MAX   64
+#define TWIN_CLEARS_MAX 256
+#define TWIN_FB_MAX     4096
+
+typedef struct
+{
+    bool            defined;
+    bool            free;
+    uint16_t        signal;
+    uint8_t         len;
+    uint16_t        fb[TWIN_PATH_MAX];
+    ticks_t         time[TWIN_PATH_MAX];
+    // Statistics
+    uint32_t        runs;
+    uint64_t        wait_sum;
+    ticks_t         wait_max;
+} twin_route_t;
+
+typedef enum
+{
+    TRAIN_IDLE,                 // Not started, or dwelling
+    TRAIN_WAIT_SIGNAL,          // Route requested
+    TRAIN_RUN,                  // On the route
+    TRAIN_DONE
+} train_state_t;
+
+typedef struct
+{
+    char            name[16];
+    train_state_t   state;
+    ticks_t         t;          // Time of next step (IDLE, RUN), or of request (WAIT_SIGNAL)
+    ticks_t         dwell;
+    uint16_t        fb;         // Section where the train is (head of train)
+    bool            repeat;
+    uint8_t         nlegs;
+    uint8_t         leg;
+    uint16_t        legs[TWIN_LEGS_MAX];
+    uint8_t         pos;        // Index in route path (RUN)
+    uint32_t        trips;
+} train_t;
+
+typedef struct
+{
+    ticks_t         t;
+    uint16_t        fb;
+} clear_t;
+
+static twin_route_t *routes;
+static train_t  trains[TWIN_TRAINS_MAX];
+static uint8_t  ntrains = 0;
+static clear_t  clears[TWIN_CLEARS_MAX];
+static uint16_t nclears = 0;
+static ticks_t  clear_time = TICKS_FROM_SEC(2);
+static uint8_t  owner[TWIN_FB_MAX + 1];         // Train index + 1 in section, 0 if empty
+static uint32_t collisions = 0;
+static uint64_t awaiting_sum = 0;
+static uint64_t active_sum = 0;
+
+
+static ticks_t seconds(const char *s)
+{
+    return (ticks_t)(atof(s) * TICKS_PER_SEC + 0.5);
+}
+
+static void model_error(const char *path, int line, const char *msg)
+{
+    fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+    exit(2);
+}
+
+static void read_model(const char *path)
+{
+    FILE           *f = fopen(path, "r");
+    char            buf[1024];
+    int             line = 0, i;
+    train_t        *t;
+
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    while (fgets(buf, sizeof(buf), f))
+    {
+        char           *tok[2 * TWIN_LEGS_MAX + 16];
+        int             n = 0;
+        char           *p;
+
+        line++;
+        if ((p = strchr(buf, '#')) != NULL)
+            *p = '\0';
+        for (p = strtok(buf, " \t\r\n"); p && n < (int)(sizeof(tok) / sizeof(tok[0])); p = strtok(NULL, " \t\r\n"))
+            tok[n++] = p;
+        if (n == 0)
+            continue;
+
+        if (!strcmp(tok[0], "clear") && n == 2)
+        {
+            clear_time = seconds(tok[1]);
+        }
+        else if (!strcmp(tok[0], "route") && n >= 6 && !strcmp(tok[2], "signal") && !strcmp(tok[4], "path"))
+        {
+            unsigned        num = strtoul(tok[1], NULL, 0);
+            twin_route_t   *r;
+
+            if (num >= TWIN_ROUTES_MAX || !route_exists(num))
+                model_error(path, line, "Route is not in the route table");
+            r = &routes[num];
+            r->defined = true;
+            r->signal = strtoul(tok[3], NULL, 0);
+            for (i = 5; i < n; i++)
+            {
+                char           *c = strchr(tok[i], ':');
+
+                if (!strcmp(tok[i], "free"))
+                {
+                    r->free = true;
+                    continue;
+                }
+                if (!c || r->len >= TWIN_PATH_MAX)
+                    model_error(path, line, "Bad path section (fb:seconds)");
+                *c = '\0';
+                r->fb[r->len] = strtoul(tok[i], NULL, 0);
+                r->time[r->len] = seconds(c + 1);
+                if (r->fb[r->len] == 0 || r->fb[r->len] > TWIN_FB_MAX)
+                    model_error(path, line, "Feedback address out of range");
+                r->len++;
+            }
+            if (r->len == 0)
+                model_error(path, line, "Route has no path");
+        }
+        else if (!strcmp(tok[0], "train") && n >= 7 && !strcmp(tok[3], "at"))
+        {
+            if (ntrains >= TWIN_TRAINS_MAX)
+                model_error(path, line, "Too many trains");
+            t = &trains[ntrains++];
+            snprintf(t->name, sizeof(t->name), "%s", tok[1]);
+            t->t = seconds(tok[2]);
+            t->fb = strtoul(tok[4], NULL, 0);
+            if (t->fb == 0 || t->fb > TWIN_FB_MAX)
+                model_error(path, line, "Feedback address out of range");
+            i = 5;
+            if (i + 1 < n && !strcmp(tok[i], "dwell"))
+            {
+                t->dwell = seconds(tok[i + 1]);
+                i += 2;
+            }
+            if (i >= n || strcmp(tok[i], "routes"))
+                model_error(path, line, "Expected 'routes'");
+            for (i++; i < n; i++)
+            {
+                if (!strcmp(tok[i], "repeat"))
+                    t->repeat = true;
+                else if (t->nlegs < TWIN_LEGS_MAX)
+                    t->legs[t->nlegs++] = strtoul(tok[i], NULL, 0);
+                else
+                    model_error(path, line, "Too many routes");
+            }
+            if (t->nlegs == 0)
+                model_error(path, line, "Train has no routes");
+        }
+        else
+        {
+            model_error(path, line, "Syntax error");
+        }
+    }
+    fclose(f);
+
+    for (t = trains; t < trains + ntrains; t++)
+        for (i = 0; i < t->nlegs; i++)
+            if (t->legs[i] >= TWIN_ROUTES_MAX || !routes[t->legs[i]].defined)
+            {
+                fprintf(stderr, "%s: train %s: route %u has no 'route' line\n", path, t->name, t->legs[i]);
+                exit(2);
+            }
+}
+
+
+static void enter(train_t *t, uint16_t fb)
+{
+    uint8_t         idx = t - trains;
+
+    if (owner[fb] && owner[fb] != idx + 1)
+    {
+        printf("%9.1f COLLISION: %s enters section %u occupied by %s\n", host_time() / (double)TICKS_PER_SEC,
+               t->name, fb, trains[owner[fb] - 1].name);
+        collisions++;
+    }
+    owner[fb] = idx + 1;
+    host_rx_input_rep(fb, true);
+
+    // Tail clears the previous section a bit later
+    if (nclears < TWIN_CLEARS_MAX)
+    {
+        clears[nclears].t = host_time() + clear_time;
+        clears[nclears].fb = t->fb;
+        nclears++;
+    }
+    t->fb = fb;
+}
+
+static void clear_update(void)
+{
+    uint16_t        i = 0;
+
+    while (i < nclears)
+    {
+        if ((int32_t)(host_time() - clears[i].t) >= 0)
+        {
+            uint16_t        fb = clears[i].fb;
+
+            clears[i] = clears[--nclears];
+            // Only if no train has entered it since
+            if (owner[fb] && trains[owner[fb] - 1].fb != fb)
+            {
+                owner[fb] = 0;
+                host_rx_input_rep(fb, false);
+            }
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static void train_update(train_t *t)
+{
+    ticks_t         now = host_time();
+    uint16_t        num = t->legs[t->leg];
+    twin_route_t   *r = &routes[num];
+
+    switch (t->state)
+    {
+    case TRAIN_IDLE:
+        if ((int32_t)(now - t->t) < 0)
+            break;
+        if (route_state(num) == ROUTE_FREE)
+            route_request(num);
+        t->t = now;
+        t->state = TRAIN_WAIT_SIGNAL;
+        break;
+
+    case TRAIN_WAIT_SIGNAL:
+        if (!sw_handler_get_state(r->signal))
+            break;
+        r->runs++;
+        r->wait_sum += now - t->t;
+        if (now - t->t > r->wait_max)
+            r->wait_max = now - t->t;
+        t->pos = 0;
+        enter(t, r->fb[0]);
+        t->t = now + r->time[0];
+        t->state = TRAIN_RUN;
+        break;
+
+    case TRAIN_RUN:
+        if ((int32_t)(now - t->t) < 0)
+            break;
+        if (++t->pos < r->len)
+        {
+            enter(t, r->fb[t->pos]);
+            t->t = now + r->time[t->pos];
+            break;
+        }
+
+        // Arrived at the last section of the route
+        if (r->free)
+            route_free(num);
+        if (++t->leg >= t->nlegs)
+        {
+            t->trips++;
+            t->leg = 0;
+            if (!t->repeat)
+            {
+                t->state = TRAIN_DONE;
+                break;
+            }
+        }
+        t->t = now + t->dwell;
+        t->state = TRAIN_IDLE;
+        break;
+
+    case TRAIN_DONE:
+        break;
+    }
+}
+
+static void sample_routes(void)
+{
+    unsigned        num;
+
+    for (num = 0; num < MAXROUTES; num++)
+    {
+        route_state_t   st = route_state(num);
+
+        if (st == ROUTE_AWAITCSTR)
+            awaiting_sum++;
+        else if (st == ROUTE_ACTIVE)
+            active_sum++;
+    }
+}
+
+
+static void report(double hours)
+{
+    host_stat_t     st;
+    ticks_t         elapsed = host_time();
+    uint32_t        legs = 0, trips = 0;
+    unsigned        num;
+    int             i;
+
+    host_stat(&st);
+    for (i = 0; i < ntrains; i++)
+        trips += trains[i].trips;
+    for (num = 0; num < TWIN_ROUTES_MAX; num++)
+        legs += routes[num].runs;
+
+    printf("\nSimulated %.2f hours, %u trains\n", hours, ntrains);
+    printf("Throughput:  %.1f trains/hour (completed timetables), %.1f routes/hour\n", trips / hours, legs / hours);
+    printf("Collisions:  %u\n", collisions);
+
+    printf("\nTrain            trips\n");
+    for (i = 0; i < ntrains; i++)
+        printf("%-16s %5u\n", trains[i].name, trains[i].trips);
+
+    printf("\nRoute   runs  avg wait s  max wait s\n");
+    for (num = 0; num < TWIN_ROUTES_MAX; num++)
+    {
+        twin_route_t   *r = &routes[num];
+
+        if (!r->defined)
+            continue;
+        printf("%5u %6u %11.2f %11.2f\n", num, r->runs, r->runs ? r->wait_sum / (double)r->runs / TICKS_PER_SEC : 0.0,
+               r->wait_max / (double)TICKS_PER_SEC);
+    }
+
+    printf("\nRoutes waiting for constraints: %.2f avg\n", awaiting_sum / (double)elapsed);
+    printf("Routes active:                  %.2f avg\n", active_sum / (double)elapsed);
+    printf("Route send queue:  peak %u, dropped %u\n", st.rq_peak, st.rq_dropped);
+    printf("Switch queue:      peak %u, dropped %u, busy %.1f %%\n", st.swq_peak, st.swq_dropped,
+           100.0 * st.swq_busy / elapsed);
+    printf("Loconet:           %u INPUT_REP, %u SW_REQ sent, %u received, busy %.1f %%, tx full %u\n",
+           st.tx_fb, st.tx_sw, st.rx, 100.0 * st.busy / elapsed, st.tx_full);
+}
+
+
+int main(int argc, char *argv[])
+{
+    double          hours = 1.0;
+    ticks_t         end;
+    int             i;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <model> [hours]\n", argv[0]);
+        return 2;
+    }
+    if (argc >= 3)
+        hours = atof(argv[2]);
+
+    routes = calloc(TWIN_ROUTES_MAX, sizeof(*routes));
+    host_init();
+    read_model(argv[1]);
+
+    // Trains are in their start sections
+    for (i = 0; i < ntrains; i++)
+    {
+        owner[trains[i].fb] = i + 1;
+        host_rx_input_rep(trains[i].fb, true);
+    }
+
+    end = (ticks_t)(hours * 3600 * TICKS_PER_SEC);
+    while (host_time() < end)
+    {
+        host_run(1);
+        clear_update();
+        for (i = 0; i < ntrains; i++)
+            train_update(&trains[i]);
+        sample_routes();
+    }
+
+    report(hours);
+    return collisions ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""
+twin.py
+
+Digital twin: simulated trains driving the real route engine on the host.
+
+Builds twin.c with the route engine and the layout files (see
+hostbuild.py), and runs the model for the given time. Reports
+throughput, wait per route, queue use and Loconet load. See twin.c for
+the model file format, and example/ for a small layout.
+
+Compare scheduling changes by running the same model before and after.
+
+Usage:
+  twin.py layout.c [more.c ...] model [--hours 2] [-D MAXROUTES=400] [--cc clang]
+  twin.py example/loop_layout.c example/loop.model
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+import hostbuild
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("layout", nargs="+", help="Layout C files")
+    ap.add_argument("model", help="Model file")
+    ap.add_argument("--hours", type=float, default=1, help="Simulated time")
+    ap.add_argument("-D", dest="defines", action="append", default=[], help="Firmware define, e.g. MAXROUTES=400")
+    ap.add_argument("--cc", help="Host C compiler (default $CC or cc)")
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        exe = os.path.join(tmp, "twin")
+        hostbuild.build("twin.c", args.layout, exe, args.defines, args.cc)
+        sys.exit(subprocess.run([exe, args.model, str(args.hours)]).returncode)
+
+
+if __name__ == "__main__":
+    main()
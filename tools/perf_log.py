@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+perf_log.py
+
+Collect firmware performance numbers from routectrl3 over the shell and
+append them to a CSV file, so they can be tracked from build to build.
+
+Runs 'perf r' and 'loop', waits while the board runs (feed it traffic
+from a layout or a Loconet test tool), then runs 'loop' and
+'perf' and records:
+  loops, avg loop us, max loop cycles, stack peak,
+  INPUT_REP, SW_REQ and route_update count/avg/max cycles
+  (route_update only in a build with PERF_ROUTE_TIMING defined),
+  and flash/RAM footprint if --elf is given (uses avr-size)
+
+Usage:
+  perf_log.py /dev/ttyACM0 perf.csv [--time 10] [--label v1.2] [--elf routectrl3.elf]
+"""
+
+import argparse
+import csv
+import datetime
+import os
+import re
+import subprocess
+import time
+
+import serial
+
+FIELDS = ["date", "label", "loops", "avg_loop_us", "max_loop_cycles", "stack_peak",
+          "fb_cnt", "fb_avg", "fb_max", "sw_cnt", "sw_avg", "sw_max",
+          "ru_cnt", "ru_avg", "ru_max", "text", "data", "bss"]
+
+
+def command(port, cmd, wait=0.5):
+    port.reset_input_buffer()
+    port.write(cmd.encode() + b"\r")
+    time.sleep(wait)
+    return port.read(port.in_waiting).decode("latin-1")
+
+
+def git_label():
+    try:
+        return subprocess.check_output(["git", "describe", "--always", "--dirty"],
+                                       cwd=os.path.dirname(os.path.abspath(__file__)), text=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def elf_sizes(elf):
+    out = subprocess.check_output(["avr-size", "-A", elf], text=True)
+    sizes = {}
+    for line in out.splitlines():
+        f = line.split()
+        if len(f) >= 2 and f[1].isdigit():
+            sizes[f[0]] = int(f[1])
+    text = sum(v for k, v in sizes.items() if k in (".text", "routetables", ".rodata"))
+    return text, sizes.get(".data", 0), sizes.get(".bss", 0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("port", help="Serial port")
+    ap.add_argument("csv", help="CSV file to append to")
+    ap.add_argument("--time", type=float, default=10, help="Seconds to run between reset and readout")
+    ap.add_argument("--label", default=None, help="Label for this run (default: git describe)")
+    ap.add_argument("--elf", default=None, help="Firmware ELF file for footprint")
+    args = ap.parse_args()
+
+    port = serial.Serial(args.port, 115200, timeout=1)
+    command(port, "perf r")
+    command(port, "loop")
+    time.sleep(args.time)
+    loop = command(port, "loop")
+    perf = command(port, "perf")
+
+    row = {"date": datetime.datetime.now().isoformat(timespec="seconds"),
+           "label": args.label if args.label is not None else git_label()}
+    m = re.search(r"Loops:\s+(\d+)", loop)
+    row["loops"] = m.group(1) if m else ""
+    m = re.search(r"Avg loop:\s+(\d+)", loop)
+    row["avg_loop_us"] = m.group(1) if m else ""
+    m = re.search(r"Max loop:.*\((\d+) cycles\)", loop)
+    row["max_loop_cycles"] = m.group(1) if m else ""
+    m = re.search(r"Stack peak:\s+(\d+)", perf)
+    row["stack_peak"] = m.group(1) if m else ""
+    for key, name in (("fb", "INPUT_REP"), ("sw", "SW_REQ"), ("ru", "route_update")):
+        m = re.search(name + r"\s+(\d+)\s+(\d+)\s+(\d+)", perf)
+        for i, f in enumerate(("cnt", "avg", "max")):
+            row[key + "_" + f] = m.group(i + 1) if m else ""
+    row["text"], row["data"], row["bss"] = elf_sizes(args.elf) if args.elf else ("", "", "")
+
+    new = not os.path.exists(args.csv)
+    with open(args.csv, "a", newline="") as f:
+        w = csv.DictWriter(f, fieldnames=FIELDS)
+        if new:
+            w.writeheader()
+        w.writerow(row)
+    print(", ".join("%s=%s" % (k, row[k]) for k in FIELDS))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""
+route_graph.py
+
+Capacity analysis of the route set, from the route constraints.
+
+Builds the route conflict graph (two routes conflict if either has a
+CSTR_RT() constraint on the other) and reports:
+  - asymmetric constraints: A has a constraint on B, but B not on A.
+    B can then activate while A is active.
+  - capacity: the largest number of routes that can be active together,
+    and one such set (maximum independent set of the conflict graph)
+  - bottlenecks: routes that lower the capacity the most while active
+    (capacity minus the largest set that includes the route), and the
+    number of routes each one conflicts with
+  - what-if: capacity after adding or removing constraints
+
+Feedback constraints (CSTR_FB) are not part of the graph.
+
+Routes are read from a built ELF (like route_table_check.py), or from
+layout C files where ROUTE() uses numeric route numbers (like the output
+of gen_layout.py).
+
+Usage:
+  route_graph.py routectrl3.elf [--maxroutes 200]
+  route_graph.py layout.c [--add 12-14] [--add 3>7] [--remove 5-6] [--top 10]
+    --add A-B    constraint both ways, --add A>B  A gets CSTR_RT(B)
+    --remove A-B removes the constraints both ways
+"""
+
+import argparse
+import re
+import sys
+
+import route_table_check
+
+CSTR_TYPE_MASK = route_table_check.CSTR_TYPE_MASK
+CSTR_TYPE_RT = route_table_check.CSTR_TYPE_RT
+
+
+class Budget(Exception):
+    pass
+
+
+def split_args(text, start):
+    """Split the macro arguments starting after '(' at start. Returns (args, end)."""
+    args = []
+    depth = 0
+    cur = ""
+    i = start
+    while i < len(text):
+        c = text[i]
+        if c == "(":
+            depth += 1
+        elif c == ")":
+            if depth == 0:
+                args.append(cur.strip())
+                return args, i
+            depth -= 1
+        elif c == "," and depth == 0:
+            args.append(cur.strip())
+            cur = ""
+            i += 1
+            continue
+        cur += c
+        i += 1
+    return None, i
+
+
+def read_c(paths):
+    routes = {}
+    for path in paths:
+        with open(path) as f:
+            text = re.sub(r"/\*.*?\*/|//[^\n]*", "", f.read(), flags=re.S)
+        for m in re.finditer(r"^\s*ROUTE\s*\(", text, re.M):
+            args, end = split_args(text, m.end())
+            if args is None or len(args) < 4:
+                continue
+            if not args[0].isdigit():
+                sys.stderr.write("%s: skipping ROUTE(%s, ...), route number is not numeric\n" % (path, args[0]))
+                continue
+            cstrs = []
+            for a in args[4:]:
+                c = re.fullmatch(r"(?:CSTR_RT\s*\(\s*(\d+)\s*\)|(\d+))", a)
+                if c:
+                    cstrs.append(int(c.group(1) or c.group(2)))
+                elif not a.startswith("CSTR_FB"):
+                    sys.stderr.write("%s: route %s: constraint '%s' not understood\n" % (path, args[0], a))
+            routes[int(args[0])] = cstrs
+    return routes
+
+
+def read_elf(path, args):
+    elf = route_table_check.Elf(path)
+    routes = route_table_check.Checker(elf, args).routes()
+    return {num: [c for c in cstrs if c & CSTR_TYPE_MASK == CSTR_TYPE_RT] for num, cstrs in routes.items()}
+
+
+class Graph:
+    def __init__(self, routes, limit):
+        self.nums = sorted(routes)
+        self.index = {n: i for i, n in enumerate(self.nums)}
+        self.cstr = {n: set(c for c in cstrs if c in routes and c != n) for n, cstrs in routes.items()}
+        self.limit = limit
+        self.exact = True
+        self.build()
+
+    def build(self):
+        self.adj = [0] * len(self.nums)
+        for a, cs in self.cstr.items():
+            for b in cs:
+                self.adj[self.index[a]] |= 1 << self.index[b]
+                self.adj[self.index[b]] |= 1 << self.index[a]
+        self.memo = {}
+
+    def asymmetric(self):
+        return sorted((a, b) for a, cs in self.cstr.items() for b in cs if a not in self.cstr[b])
+
+    def bits(self, mask):
+        while mask:
+            low = mask & -mask
+            yield low.bit_length() - 1
+            mask ^= low
+
+    def components(self, mask):
+        comps = []
+        while mask:
+            comp = front = mask & -mask
+            while front:
+                nb = 0
+                for i in self.bits(front):
+                    nb |= self.adj[i]
+                front = nb & mask & ~comp
+                comp |= front
+            comps.append(comp)
+            mask &= ~comp
+        return comps
+
+    def mis(self, mask):
+        """Maximum independent set within mask. Returns set as bitmask."""
+        if mask in self.memo:
+            return self.memo[mask]
+        self.nodes += 1
+        if self.nodes > self.limit:
+            raise Budget()
+
+        best = 0
+        comps = self.components(mask)
+        if len(comps) > 1:
+            for comp in comps:
+                best |= self.mis(comp)
+        elif mask:
+            deg = [(bin(self.adj[i] & mask).count("1"), i) for i in self.bits(mask)]
+            d, v = min(deg)
+            if d <= 1:
+                # A vertex of degree 0 or 1 is always in some maximum set
+                best = (1 << v) | self.mis(mask & ~(self.adj[v] | (1 << v)))
+            else:
+                d, v = max(deg)
+                take = (1 << v) | self.mis(mask & ~(self.adj[v] | (1 << v)))
+                skip = self.mis(mask & ~(1 << v))
+                best = take if bin(take).count("1") >= bin(skip).count("1") else skip
+        self.memo[mask] = best
+        return best
+
+    def greedy(self, mask):
+        best = 0
+        while mask:
+            v = min(self.bits(mask), key=lambda i: bin(self.adj[i] & mask).count("1"))
+            best |= 1 << v
+            mask &= ~(self.adj[v] | (1 << v))
+        return best
+
+    def max_set(self, mask):
+        if self.exact:
+            try:
+                return self.mis(mask)
+            except Budget:
+                self.exact = False
+        return self.greedy(mask)
+
+    def capacity(self):
+        """Returns (capacity, set of routes, {route: (cost, degree)})."""
+        full = (1 << len(self.nums)) - 1
+        self.nodes = 0
+        self.exact = True
+        comps = self.components(full)
+        best = {}
+        for comp in comps:
+            best[comp] = self.max_set(comp)
+        total = 0
+        routes = []
+        for s in best.values():
+            total += bin(s).count("1")
+            routes += [self.nums[i] for i in self.bits(s)]
+
+        cost = {}
+        for comp in comps:
+            cap = bin(best[comp]).count("1")
+            for i in self.bits(comp):
+                if best[comp] >> i & 1:
+                    c = 0
+                else:
+                    rest = comp & ~(self.adj[i] | (1 << i))
+                    c = max(cap - 1 - bin(self.max_set(rest)).count("1"), 0)
+                cost[self.nums[i]] = (c, bin(self.adj[i]).count("1"))
+        return total, sorted(routes), cost
+
+
+def parse_edge(text):
+    m = re.fullmatch(r"(\d+)([->])(\d+)", text)
+    if not m:
+        raise argparse.ArgumentTypeError("'%s' is not A-B or A>B" % text)
+    return int(m.group(1)), m.group(2), int(m.group(3))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("input", nargs="+", help="Firmware ELF file, or layout C files")
+    ap.add_argument("--maxroutes", type=int, default=200, help="MAXROUTES the firmware is built with (ELF)")
+    ap.add_argument("--add", type=parse_edge, action="append", default=[], help="Add constraint A-B or A>B")
+    ap.add_argument("--remove", type=parse_edge, action="append", default=[], help="Remove constraint A-B")
+    ap.add_argument("--top", type=int, default=10, help="Number of bottleneck routes to list")
+    ap.add_argument("--limit", type=int, default=100000, help="Search limit before falling back to greedy")
+    args = ap.parse_args()
+    args.search = None
+    args.fb_max = 4096
+    args.sw_max = 2048
+
+    if args.input[0].endswith(".c"):
+        routes = read_c(args.input)
+    else:
+        routes = read_elf(args.input[0], args)
+    if not routes:
+        sys.exit("No routes found")
+
+    g = Graph(routes, args.limit)
+    undefined = sorted(set(c for n, cs in routes.items() for c in cs if c not in routes))
+    print("Routes: %u, conflicts: %u" % (len(routes), sum(bin(a).count("1") for a in g.adj) // 2))
+    if undefined:
+        print("Constraints on undefined routes (ignored): %s" % " ".join(map(str, undefined)))
+
+    asym = g.asymmetric()
+    print()
+    print("Asymmetric constraints: %u" % len(asym))
+    for a, b in asym:
+        print("  route %u has a constraint on %u, but not the reverse" % (a, b))
+
+    cap, active, cost = g.capacity()
+    print()
+    print("Capacity: %s%u routes active together" % ("" if g.exact else "at least ", cap))
+    print("  " + " ".join(map(str, active)))
+
+    print()
+    print("Bottlenecks (capacity lost while active, conflicting routes):")
+    worst = sorted(cost.items(), key=lambda kv: (-kv[1][0], -kv[1][1], kv[0]))
+    for num, (c, d) in worst[:args.top]:
+        print("  route %4u  -%u  %u conflicts" % (num, c, d))
+
+    if args.add or args.remove:
+        for a, kind, b in args.add:
+            for n in (a, b):
+                if n not in g.cstr:
+                    sys.exit("Route %u is not defined" % n)
+            g.cstr[a].add(b)
+            if kind == "-":
+                g.cstr[b].add(a)
+        for a, kind, b in args.remove:
+            g.cstr.get(a, set()).discard(b)
+            if kind == "-":
+                g.cstr.get(b, set()).discard(a)
+        g.build()
+        newcap, newactive, newcost = g.capacity()
+        print()
+        print("What-if: capacity %u -> %s%u (%+d)" % (cap, "" if g.exact else "at least ", newcap, newcap - cap))
+        print("  " + " ".join(map(str, newactive)))
+        for a, kind, b in args.add + args.remove:
+            for n in (a, b):
+                print("  route %4u  -%u -> -%u  %u -> %u conflicts" % (n, cost[n][0], newcost[n][0], cost[n][1], newcost[n][1]))
+
+    if not g.exact:
+        print()
+        print("Note: search limit reached, capacity is a greedy lower bound (raise --limit)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+"""
+route_table_check.py
+
+Check the Loconet tables (ROUTE(), FEEDBACK_*(), SWITCH_REQ*(), REFLEX_*(),
+LOCAL_FB_*() and LOCAL_OUT_*()) in a built routectrl3 ELF file.
+
+Reads the tables between the __loconet_*_start/_end symbols placed by
+routetables.ld and reports:
+  errors:   duplicate route numbers, route numbers >= MAXROUTES, tables
+            that are not sorted although the firmware uses binary search,
+            subscribers for the same address that are not next to each
+            other, constraints on undefined routes, unknown constraint
+            types, feedback/switch addresses out of range, empty address
+            ranges and overlapping local inputs/outputs
+  warnings: route constraints that are ignored (>= MAXROUTES) or on
+            the route itself
+  sizes:    entries and bytes per table, and the expected number of
+            entries visited per lookup (linear or binary search)
+  footprint: flash and RAM use of the whole image
+
+Binary search is assumed if the ELF was built with GCC 15 or later
+(read from the .comment section), like the __GNUC__ < 15 tests in the
+firmware. Sizes follow the AVR layout of the tables (packed, 16-bit
+data pointers, 24-bit FLASHMEM pointers).
+
+Runs as post build step (see routectrl3.cproj), with the limits from
+the MaxRoutes, FeedbackAdrMax and SwAdrMax project properties that the
+firmware is compiled with. The PythonExe property selects the Python 3
+interpreter (default 'py -3'). Exit code is 1 if there are errors.
+
+Usage:
+  route_table_check.py routectrl3.elf [--maxroutes 200] [--fb-max 4096]
+                       [--sw-max 2048] [--search linear|binary] [-q]
+"""
+
+import argparse
+import math
+import re
+import struct
+import sys
+
+RAM_BASE = 0x800000             # avr-gcc address spaces. Flash is below RAM
+EEPROM_BASE = 0x810000
+EEPROM_END = 0x820000           # Fuses, lock bits and signature from here
+
+CSTR_DATA_MASK = 0x0fff
+CSTR_TYPE_MASK = 0xf000
+CSTR_TYPE_RT = 0x0000
+CSTR_TYPE_FB = 0x1000
+
+LOCAL_OUT_TYPES = ("GPIO", "SR", "I2C")
+
+
+class Elf:
+    """Minimal ELF32 little-endian reader: sections and symbols."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF" or d[4] != 1 or d[5] != 1:
+            raise ValueError("%s: not a 32-bit little-endian ELF file" % path)
+        shoff, = struct.unpack_from("<I", d, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x2e)
+
+        raw = [struct.unpack_from("<IIIIIIIIII", d, shoff + i * shentsize) for i in range(shnum)]
+        names = raw[shstrndx][4]
+        self.sections = []
+        for name, typ, flags, addr, offset, size, link, info, align, entsize in raw:
+            self.sections.append({"name": self.cstr(names + name), "type": typ, "flags": flags,
+                                  "addr": addr, "offset": offset, "size": size, "link": link})
+
+        self.symbols = {}
+        self.sizes = {}
+        for s in self.sections:
+            if s["type"] != 2:          # SHT_SYMTAB
+                continue
+            strtab = self.sections[s["link"]]["offset"]
+            for off in range(s["offset"], s["offset"] + s["size"], 16):
+                name, value, size, info, other, shndx = struct.unpack_from("<IIIBBH", d, off)
+                if name:
+                    n = self.cstr(strtab + name)
+                    self.symbols[n] = value
+                    self.sizes[n] = size
+
+    def cstr(self, off):
+        return self.data[off:self.data.index(b"\0", off)].decode("latin-1")
+
+    def section(self, name):
+        for s in self.sections:
+            if s["name"] == name:
+                return s
+        return None
+
+    def read(self, addr, size):
+        """Read bytes at a flash address."""
+        for s in self.sections:
+            if s["type"] == 1 and s["addr"] <= addr and addr + size <= s["addr"] + s["size"] \
+                    and s["addr"] < RAM_BASE:
+                off = s["offset"] + addr - s["addr"]
+                return self.data[off:off + size]
+        return None
+
+    def gcc_major(self):
+        s = self.section(".comment")
+        if s:
+            m = re.search(rb"GCC: \([^)]*\) (\d+)\.", self.data[s["offset"]:s["offset"] + s["size"]])
+            if m:
+                return int(m.group(1))
+        return None
+
+
+class Checker:
+    def __init__(self, elf, args):
+        self.elf = elf
+        self.args = args
+        self.errors = 0
+        self.warnings = 0
+        self.tables = []
+        self.gcc = elf.gcc_major()
+        if args.search:
+            self.binary = args.search == "binary"
+        else:
+            self.binary = self.gcc is not None and self.gcc >= 15
+
+    def error(self, msg):
+        self.errors += 1
+        print("ERROR: " + msg)
+
+    def warning(self, msg):
+        self.warnings += 1
+        print("Warning: " + msg)
+
+    def table(self, name, entsize):
+        """Return the raw entries of a table."""
+        start = self.elf.symbols.get("__loconet_%s_start" % name)
+        end = self.elf.symbols.get("__loconet_%s_end" % name)
+        if start is None or end is None:
+            self.error("%s: no __loconet_%s_start/_end symbols (routetables.ld not used?)" % (name, name))
+            return []
+        size = end - start
+        if size % entsize:
+            self.error("%s: size %u is not a multiple of the entry size %u" % (name, size, entsize))
+            return []
+        data = self.elf.read(start, size) if size else b""
+        if data is None:
+            self.error("%s: table at 0x%x not found in a flash section" % (name, start))
+            return []
+        entries = [data[i:i + entsize] for i in range(0, size, entsize)]
+        self.tables.append((name, len(entries), size, entsize))
+        return entries
+
+    def check_sorted(self, name, keys):
+        """Keys in table order. Same keys must be adjacent, and sorted for binary search."""
+        seen = set()
+        prev = None
+        for k in keys:
+            if k != prev and k in seen:
+                self.error("%s: entries for %u are not next to each other" % (name, k))
+            if self.binary and prev is not None and k < prev:
+                self.error("%s: not sorted (%u after %u), binary search will fail" % (name, k, prev))
+            seen.add(k)
+            prev = k
+
+    def check_adr(self, name, adr, maxadr):
+        if adr == 0 or adr > maxadr:
+            self.error("%s: address %u out of range 1..%u" % (name, adr, maxadr))
+
+    def routes(self):
+        """Check the route table. Returns {route number: [constraints]}."""
+        args = self.args
+        rnsize = 1 if args.maxroutes <= 256 else 2
+        entsize = None
+        for n, v in self.elf.sizes.items():
+            if n.startswith("routeentry") and v:
+                entsize = v
+                break
+        if entsize is None:
+            entsize = rnsize + 2 + 3 + 3 * 2
+        ptrsize = entsize - rnsize - 2 - 3 * 2
+        if ptrsize not in (2, 3):
+            self.error("routetable: entry size %u does not match MAXROUTES %u" % (entsize, args.maxroutes))
+            return {}
+
+        routes = {}
+        nums = []
+        for e in self.table("routetable", entsize):
+            num = e[0] if rnsize == 1 else struct.unpack_from("<H", e)[0]
+            cnt, = struct.unpack_from("<H", e, rnsize)
+            ptr = int.from_bytes(e[rnsize + 2:rnsize + 2 + ptrsize], "little") & 0x7fffff
+            nums.append(num)
+            if num in routes:
+                self.error("route %u: defined more than once" % num)
+                continue
+            if num >= args.maxroutes:
+                self.error("route %u: route number >= MAXROUTES (%u)" % (num, args.maxroutes))
+            cstr = self.elf.read(ptr, cnt * 2) if cnt else b""
+            if cstr is None:
+                self.error("route %u: constraints at 0x%x not found in flash" % (num, ptr))
+                cstr = b""
+            routes[num] = list(struct.unpack("<%uH" % (len(cstr) // 2), cstr))
+        self.check_sorted("routetable", nums)
+
+        cstrbytes = 0
+        for num, cstrs in routes.items():
+            cstrbytes += len(cstrs) * 2
+            for c in cstrs:
+                typ, data = c & CSTR_TYPE_MASK, c & CSTR_DATA_MASK
+                if typ == CSTR_TYPE_RT:
+                    if c >= args.maxroutes:
+                        self.warning("route %u: constraint on route %u >= MAXROUTES is ignored" % (num, c))
+                    elif c not in routes:
+                        self.error("route %u: constraint on undefined route %u" % (num, c))
+                    elif c == num:
+                        self.warning("route %u: constraint on itself" % num)
+                elif typ == CSTR_TYPE_FB:
+                    self.check_adr("route %u: feedback constraint" % num, data, args.fb_max)
+                else:
+                    self.error("route %u: unknown constraint type 0x%04x" % (num, c))
+        self.tables.append(("(route constraints)", sum(len(c) for c in routes.values()), cstrbytes, 2))
+        return routes
+
+    def addr_table(self, name, maxadr, sort):
+        keys = []
+        for e in self.table(name, 4):
+            adr, = struct.unpack_from("<H", e)
+            self.check_adr(name, adr, maxadr)
+            keys.append(adr)
+        if sort:
+            self.check_sorted(name, keys)
+
+    def range_table(self, name, maxadr):
+        for e in self.table(name, 6):
+            first, last = struct.unpack_from("<HH", e)
+            self.check_adr(name, first, maxadr)
+            self.check_adr(name, last, maxadr)
+            if first > last:
+                self.error("%s: empty range %u..%u" % (name, first, last))
+
+    def reflex(self):
+        keys = []
+        for e in self.table("reflextable", 6):
+            fb, sw = struct.unpack_from("<HH", e)
+            self.check_adr("reflextable: feedback", fb, self.args.fb_max)
+            self.check_adr("reflextable: switch", sw, self.args.sw_max)
+            keys.append(fb)
+        self.check_sorted("reflextable", keys)
+
+    def pins(self, name, entries, fmt, maxadr):
+        used = {}
+        for e in entries:
+            mask, adr = struct.unpack_from(fmt, e)
+            for bit in range(8):
+                if mask & (1 << bit):
+                    a = adr + bit
+                    self.check_adr(name, a, maxadr)
+                    if a in used:
+                        self.error("%s: address %u used more than once" % (name, a))
+                    used[a] = True
+
+    def lookup_cost(self, n):
+        """Expected entries visited per lookup: (hit, miss)."""
+        if n == 0:
+            return 0, 0
+        if self.binary:
+            c = math.ceil(math.log2(n + 1))
+            return c, c
+        return (n + 1) / 2, n
+
+    def run(self):
+        args = self.args
+        print("Compiler: %s, %s search" % ("GCC %u" % self.gcc if self.gcc else "unknown",
+                                           "binary" if self.binary else "linear"))
+
+        self.routes()
+        self.addr_table("fbocctable", args.fb_max, True)
+        self.addr_table("fbfreetable", args.fb_max, True)
+        self.range_table("fbrangeocctable", args.fb_max)
+        self.range_table("fbrangefreetable", args.fb_max)
+        self.addr_table("swreqtable", args.sw_max, True)
+        self.range_table("swreqrangetable", args.sw_max)
+        self.reflex()
+        self.pins("localfbtable", self.table("localfbtable", 9), "<xxxxxBxH", args.fb_max)
+        lout = self.table("localouttable", 8)
+        for e in lout:
+            if e[2] >= len(LOCAL_OUT_TYPES):
+                self.error("localouttable: unknown type %u" % e[2])
+        self.pins("localouttable", lout, "<xxxxBxH", args.sw_max)
+
+        if not args.quiet:
+            self.report()
+        print("%u error(s), %u warning(s)" % (self.errors, self.warnings))
+        return self.errors == 0
+
+    def report(self):
+        searched = ("routetable", "fbocctable", "fbfreetable", "swreqtable", "reflextable")
+        print()
+        print("Table                 entries    bytes   visited/lookup (hit/miss)")
+        for name, n, size, entsize in self.tables:
+            if name in searched:
+                hit, miss = self.lookup_cost(n)
+                cost = "%8.1f %6u" % (hit, miss)
+            elif name.startswith("("):
+                cost = ""
+            else:
+                cost = "%8u %6u (all entries)" % (n, n)
+            print("%-20s %8u %8u %s" % (name, n, size, cost))
+
+        flash = ram = eeprom = 0
+        for s in self.elf.sections:
+            if not s["flags"] & 2:      # SHF_ALLOC
+                continue
+            if s["addr"] < RAM_BASE:
+                flash += s["size"]
+            elif s["addr"] < EEPROM_BASE:
+                ram += s["size"]
+                if s["type"] == 1:      # Initialized data is also stored in flash
+                    flash += s["size"]
+            elif s["addr"] < EEPROM_END:
+                eeprom += s["size"]
+        rt = self.elf.section("routetables")
+        print()
+        print("Flash: %u bytes (tables %u)" % (flash, rt["size"] if rt else 0))
+        print("RAM:   %u bytes static" % ram)
+        if eeprom:
+            print("EEPROM: %u bytes" % eeprom)
+        print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf", help="Firmware ELF file")
+    ap.add_argument("--maxroutes", type=int, default=200, help="MAXROUTES the firmware is built with")
+    ap.add_argument("--fb-max", type=int, default=4096, help="FEEDBACK_ADR_MAX the firmware is built with")
+    ap.add_argument("--sw-max", type=int, default=2048, help="SW_ADR_MAX the firmware is built with")
+    ap.add_argument("--search", choices=("linear", "binary"), help="Override search type from compiler version")
+    ap.add_argument("-q", "--quiet", action="store_true", help="Only print errors and warnings")
+    args = ap.parse_args()
+
+    try:
+        elf = Elf(args.elf)
+    except (OSError, ValueError) as e:
+        sys.exit("route_table_check: %s" % e)
+    if not Checker(elf, args).run():
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
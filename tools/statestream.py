@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""
+statestream.py
+
+Decode the machine readable state stream from routectrl3 (see statestream.c).
+
+Reads the terminal byte stream from a file, stdin or a serial port.
+Keeps a mirror of route, feedback and switch states, and prints snapshot
+completion and every change. Trace frames and terminal text are skipped.
+Sequence number gaps and checksum errors are reported. On a serial port,
+a new snapshot is then requested (TERM_RESYNC_REQ, see term.h).
+
+Usage:
+  statestream.py capture.bin
+  statestream.py /dev/ttyACM0 --start   (requires pyserial, sends 'stream 1')
+  cat capture.bin | statestream.py -
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from trace_decode import Stream
+
+FRAME_START = 0xF1
+TRACE_FRAME_START = 0xF0
+TRACE_REC_LEN = 7
+RESYNC_REQ = b"\x12"
+
+SNAP_BEGIN = 1
+SNAP_ROUTE = 2
+SNAP_FB = 3
+SNAP_SW = 4
+SNAP_END = 5
+ROUTE = 6
+FB = 7
+SW = 8
+
+ROUTE_STATES = ("FREE", "AWAITCSTR", "AWAITEXE", "ACTIVE")
+
+
+def open_input(path, start):
+    """Returns (input, resync function or None)."""
+    if path == "-":
+        return sys.stdin.buffer, None
+    if os.path.exists(path) and not os.path.isfile(path):
+        import serial
+        port = serial.Serial(path, 115200, timeout=None)
+        if start:
+            port.write(b"stream 1\r")
+        return port, lambda: port.write(RESYNC_REQ)
+    return open(path, "rb"), None
+
+
+class StateMirror:
+    def __init__(self, out, resync=None):
+        self.out = out
+        self.resync = resync
+        self.resync_sent = False
+        self.seq = None
+        self.synced = False
+        self.routes = {}
+        self.fb = {}
+        self.sw = {}
+
+    def bits(self, table, payload):
+        adr = struct.unpack_from("<H", payload)[0]
+        for byte in payload[2:]:
+            for bit in range(8):
+                table[adr] = bool(byte & (1 << bit))
+                adr += 1
+
+    def lost_sync(self):
+        self.synced = False
+        if self.resync and not self.resync_sent:
+            self.out.write("Requesting snapshot\n")
+            self.resync()
+            self.resync_sent = True
+
+    def frame(self, seq, typ, payload):
+        if self.seq is not None and seq != (self.seq + 1) & 0xff:
+            self.out.write("ERROR: sequence gap %u -> %u\n" % (self.seq, seq))
+            self.lost_sync()
+        self.seq = seq
+
+        if typ == SNAP_BEGIN:
+            self.resync_sent = False
+            self.routes.clear()
+            self.fb.clear()
+            self.sw.clear()
+            self.nroutes, self.nfb, self.nsw = struct.unpack("<HHH", payload)
+        elif typ == SNAP_ROUTE:
+            num = struct.unpack_from("<H", payload)[0]
+            for byte in payload[2:]:
+                for shift in range(0, 8, 2):
+                    self.routes[num] = (byte >> shift) & 3
+                    num += 1
+        elif typ == SNAP_FB:
+            self.bits(self.fb, payload)
+        elif typ == SNAP_SW:
+            self.bits(self.sw, payload)
+        elif typ == SNAP_END:
+            self.synced = True
+            active = sum(1 for v in self.routes.values() if v == 3)
+            occ = sum(1 for a, v in self.fb.items() if v and a <= self.nfb)
+            self.out.write("Snapshot: %u active routes, %u occupied feedbacks\n" % (active, occ))
+        elif typ in (ROUTE, FB, SW):
+            adr, val = struct.unpack("<HB", payload)
+            if typ == ROUTE:
+                self.routes[adr] = val
+                self.out.write("route %4u %s\n" % (adr, ROUTE_STATES[val & 3]))
+            elif typ == FB:
+                self.fb[adr] = bool(val)
+                self.out.write("fb    %4u %s\n" % (adr, "occ" if val else "free"))
+            else:
+                self.sw[adr] = bool(val)
+                self.out.write("sw    %4u %s\n" % (adr, "G" if val else "R"))
+            if not self.synced:
+                self.out.write("  (not synced, waiting for snapshot)\n")
+        else:
+            self.out.write("ERROR: unknown frame type %u\n" % typ)
+        self.out.flush()
+
+    def run(self, inp):
+        stream = Stream(inp)
+        while True:
+            c = stream.byte()
+            if c is None:
+                break
+            if c == TRACE_FRAME_START:
+                stream.frame(TRACE_REC_LEN)
+                continue
+            if c != FRAME_START:
+                continue
+            hdr = stream.frame(3)
+            data = stream.frame(hdr[2] + 1) if hdr is not None else None
+            if data is None:
+                self.out.write("ERROR: truncated frame\n")
+                self.lost_sync()
+                continue
+            seq, typ, length = hdr
+            check = seq ^ typ ^ length
+            for b in data[:length]:
+                check ^= b
+            if check != data[length]:
+                self.out.write("ERROR: checksum\n")
+                self.lost_sync()
+                continue
+            self.frame(seq, typ, data[:length])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("input", help="Capture file, serial port or - for stdin")
+    ap.add_argument("--start", action="store_true", help="Send 'stream 1' when opening a serial port")
+    args = ap.parse_args()
+
+    inp, resync = open_input(args.input, args.start)
+    StateMirror(sys.stdout, resync).run(inp)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+trace_decode.py
+
+Decode the binary event trace streamed by routectrl3 (see trace.h).
+
+Reads the terminal byte stream from a file, stdin or a serial port.
+Normal terminal text is passed through, trace frames are printed as text.
+XON/XOFF bytes are dropped and frame bytes unescaped (see term.h).
+Event names are read from the trace_ev_t enum in trace.h.
+Record ticks are 16 bit; SYNC records give the full ticks, and the
+records after one are placed relative to it. Before the first SYNC,
+times are relative to the start of the input.
+
+Usage:
+  trace_decode.py capture.bin
+  trace_decode.py /dev/ttyACM0          (requires pyserial)
+  cat capture.bin | trace_decode.py -
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_START = 0xF0
+REC_LEN = 7
+TICKS_PER_SEC = 1024
+
+# See term.h
+XON = 0x11
+XOFF = 0x13
+FRAME_STARTS = (0xF0, 0xF1)
+FRAME_ESC = 0xF2
+FRAME_ESC_XOR = 0x20
+
+DEFAULT_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "routectrl3", "trace.h")
+
+
+def read_event_names(header):
+    with open(header) as f:
+        src = f.read()
+    m = re.search(r"typedef enum\s*\{([^}]*)\}\s*trace_ev_t;", src)
+    if not m:
+        sys.exit("trace_ev_t not found in %s" % header)
+    body = re.sub(r"//[^\n]*|/\*.*?\*/", "", m.group(1), flags=re.S)
+    names = []
+    for item in body.split(","):
+        item = item.strip()
+        if not item:
+            continue
+        name, _, value = item.partition("=")
+        if value.strip():
+            idx = int(value.strip(), 0)
+            names.extend([None] * (idx - len(names)))
+        names.append(name.strip()[len("TRACE_EV_"):])
+    return names
+
+
+def open_input(path):
+    if path == "-":
+        return sys.stdin.buffer
+    if os.path.exists(path) and not os.path.isfile(path):
+        import serial
+        return serial.Serial(path, 115200, timeout=None)
+    return open(path, "rb")
+
+
+class Stream:
+    """Terminal byte stream with XON/XOFF dropped, and unescaping of frame bytes."""
+
+    def __init__(self, inp):
+        self.inp = inp
+        self.pending = None
+
+    def byte(self):
+        """Next byte, or None at end of input."""
+        if self.pending is not None:
+            c, self.pending = self.pending, None
+            return c
+        while True:
+            c = self.inp.read(1)
+            if not c:
+                return None
+            if c[0] not in (XON, XOFF):
+                return c[0]
+
+    def frame(self, n):
+        """Next n frame bytes, unescaped. None at end of input, or if a new frame starts
+        in the middle (the frame start is then returned by the next byte())."""
+        out = bytearray()
+        while len(out) < n:
+            c = self.byte()
+            esc = c == FRAME_ESC
+            if esc:
+                c = self.byte()
+            if c is None:
+                return None
+            if c in FRAME_STARTS:
+                self.pending = c
+                return None
+            out.append(c ^ FRAME_ESC_XOR if esc else c)
+        return bytes(out)
+
+
+class Decoder:
+    def __init__(self, names, out):
+        self.names = names
+        self.out = out
+        self.ticks_last = None
+
+    def ticks(self, t16):
+        if self.ticks_last is None:
+            self.ticks_last = t16
+        # Records are in time order, and less than 64 s after the previous one or a SYNC
+        self.ticks_last += (t16 - self.ticks_last) & 0xFFFF
+        return self.ticks_last
+
+    def record(self, rec):
+        ev, t16, a, b = struct.unpack("<BHHH", rec)
+        name = self.names[ev] if ev < len(self.names) and self.names[ev] else "EV%u" % ev
+        if name == "SYNC":
+            self.ticks_last = b << 16 | a
+        t = self.ticks(t16)
+        self.out.write("[%10.3f] %-15s %5u %5u\n" % (t / TICKS_PER_SEC, name, a, b))
+
+    def run(self, inp):
+        stream = Stream(inp)
+        text = bytearray()
+        while True:
+            c = stream.byte()
+            if c is None:
+                break
+            if c == FRAME_START:
+                rec = stream.frame(REC_LEN)
+                if rec is not None:
+                    self.record(rec)
+                    self.out.flush()
+            elif c in FRAME_STARTS:
+                # Skip statestream frame: seq, type, len, payload, check
+                hdr = stream.frame(3)
+                if hdr is not None:
+                    stream.frame(hdr[2] + 1)
+            else:
+                if c != 0x0D:
+                    text.append(c)
+                if c == 0x0A:
+                    self.out.write(text.decode("latin-1"))
+                    text.clear()
+        if text:
+            self.out.write(text.decode("latin-1"))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("input", help="Capture file, serial port or - for stdin")
+    ap.add_argument("--header", default=DEFAULT_HEADER, help="Path to trace.h")
+    args = ap.parse_args()
+
+    Decoder(read_event_names(args.header), sys.stdout).run(open_input(args.input))
+
+
+if __name__ == "__main__":
+    main()